@@ -0,0 +1,49 @@
+# Checks the disassembly of test_static_empty_loop in an optimized build of the playground: the
+# range-for loop over a StaticState must not touch memory or read a clock, and its only call must
+# be the one starting the next batch, so that the harness adds nothing to the loop body.
+#
+#   cmake -DOBJDUMP=<objdump> -DOBJECTS=<object files> -P CheckLoopDisassembly.cmake
+
+execute_process(
+    COMMAND ${OBJDUMP} -dCr --no-show-raw-insn ${OBJECTS}
+    OUTPUT_VARIABLE disassembly
+    RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "${OBJDUMP} failed")
+endif()
+
+string(REPLACE "\n" ";" lines "${disassembly}")
+set(body "")
+set(inside FALSE)
+foreach(line IN LISTS lines)
+    if(line MATCHES "^[0-9a-f]+ <.*run_static<&\\(anonymous namespace\\)::test_static_empty_loop")
+        set(inside TRUE)
+    elseif(inside AND line STREQUAL "")
+        break()
+    elseif(inside)
+        list(APPEND body "${line}")
+    endif()
+endforeach()
+if(NOT body)
+    message(FATAL_ERROR "test_static_empty_loop not found in ${OBJECTS}")
+endif()
+
+set(calls 0)
+foreach(line IN LISTS body)
+    if(line MATCHES "R_X86_64_")
+        if(NOT line MATCHES "BenchmarkState::next_range<")
+            message(FATAL_ERROR "unexpected reference in the loop:\n${line}")
+        endif()
+    elseif(line MATCHES "\tcall")
+        math(EXPR calls "${calls} + 1")
+    elseif(line MATCHES "\t(rdtsc|rdtscp|lfence|mfence|cpuid)")
+        message(FATAL_ERROR "clock read in the loop:\n${line}")
+    elseif(line MATCHES "\\(" AND NOT line MATCHES "\t(cs )?(nop[a-z]*|j[a-z]+) ")
+        message(FATAL_ERROR "memory access in the loop:\n${line}")
+    endif()
+endforeach()
+if(NOT calls EQUAL 1)
+    message(FATAL_ERROR "expected a single call to next_range(), found ${calls} calls")
+endif()
+list(JOIN body "\n" listing)
+message(STATUS "test_static_empty_loop:\n${listing}")
@@ -0,0 +1,499 @@
+// Compares two result files written by uscope::BinaryReporter, benchmark by benchmark.
+//
+//   uscope-compare [--threshold 0.05] [--alpha 0.05] [--resamples 1000] [--threads N]
+//                  baseline.bin contender.bin
+//
+// The repetitions of a benchmark are the unit of replication: each one is summarized by its median
+// per-iteration time, and each benchmark reports the ratio of the median of the contender medians
+// to the baseline one, a bootstrap confidence interval of that ratio over the repetitions and the
+// p-value of a Mann-Whitney U test between the two sets of medians. The exit status is 1 when a
+// benchmark is significantly slower by more than the threshold, which takes a few repetitions on
+// both sides: with 5 each the smallest reachable p-value is 0.008. It is 1 as well when runs failed
+// in the contender but not in the baseline.
+
+#include "uscope.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+using Run = uscope::BinaryResultFile::Run;
+
+struct Options {
+    double threshold { 0.05 };
+    double alpha { 0.05 };
+    int resamples { 1000 };
+    int threads { static_cast<int>(std::max(std::thread::hardware_concurrency(), 1U)) };
+    std::string baseline;
+    std::string contender;
+};
+
+// Median per-iteration time of one run, from its raw samples when it kept them, else from its
+// histogram, interpolating linearly within the bucket that holds the median.
+double median_ns(const Run& run)
+{
+    if (!run.samples.empty()) {
+        std::vector<double> values;
+        values.reserve(run.samples.size());
+        for (const uscope::Sample& sample : run.samples) {
+            values.push_back(sample.per_iteration_ns());
+        }
+        const size_t middle = values.size() / 2;
+        std::ranges::nth_element(values, values.begin() + static_cast<ptrdiff_t>(middle));
+        if (values.size() % 2 == 1) {
+            return values[middle];
+        }
+        const double upper = values[middle];
+        return (*std::max_element(values.begin(), values.begin() + static_cast<ptrdiff_t>(middle))
+                + upper)
+            / 2.0;
+    }
+    uint64_t total = 0;
+    for (const uscope::HistogramBucket& bucket : run.result.histogram) {
+        total += bucket.count;
+    }
+    if (total == 0) {
+        return 0.0;
+    }
+    const double rank = static_cast<double>(total) / 2.0;
+    double below = 0.0;
+    for (const uscope::HistogramBucket& bucket : run.result.histogram) {
+        const auto count = static_cast<double>(bucket.count);
+        if (below + count >= rank) {
+            const auto index = static_cast<size_t>(bucket.index);
+            const auto lower = static_cast<double>(uscope::Histogram::bucket_lower_bound(index));
+            const auto width = static_cast<double>(uscope::Histogram::bucket_width(index));
+            return (lower + (width * (rank - below) / count)) / uscope::Histogram::kUnitsPerNs;
+        }
+        below += count;
+    }
+    return 0.0;
+}
+
+double median(std::vector<double> values)
+{
+    std::ranges::sort(values);
+    const size_t middle = values.size() / 2;
+    return (values.size() % 2 == 1) ? values[middle] : (values[middle - 1] + values[middle]) / 2.0;
+}
+
+constexpr size_t kMaxExactU = 1 << 12;
+
+// Two-sided p-value of the Mann-Whitney U test between the repetition medians of two runs. The
+// exact distribution of U is used when there are no ties, as repetition counts are small, and
+// the normal approximation with the tie correction otherwise.
+double mann_whitney_p_value(const std::vector<double>& a, const std::vector<double>& b)
+{
+    if (a.empty() || b.empty()) {
+        return 1.0;
+    }
+    struct Value {
+        double value;
+        bool from_a;
+    };
+    std::vector<Value> values;
+    values.reserve(a.size() + b.size());
+    for (const double value : a) {
+        values.push_back({ value, true });
+    }
+    for (const double value : b) {
+        values.push_back({ value, false });
+    }
+    std::ranges::sort(values, {}, &Value::value);
+    double rank_sum_a = 0.0;
+    double tie_term = 0.0;
+    for (size_t first = 0; first < values.size();) {
+        size_t last = first;
+        size_t count_a = 0;
+        while (last < values.size() && values[last].value == values[first].value) {
+            count_a += values[last].from_a ? 1 : 0;
+            ++last;
+        }
+        // Tied values all get the average of the ranks they span.
+        const auto ties = static_cast<double>(last - first);
+        rank_sum_a
+            += static_cast<double>(count_a) * (static_cast<double>(first) + ((ties + 1.0) / 2.0));
+        tie_term += (ties * ties * ties) - ties;
+        first = last;
+    }
+    const auto n_a = static_cast<double>(a.size());
+    const auto n_b = static_cast<double>(b.size());
+    const double n = n_a + n_b;
+    const double u = rank_sum_a - (n_a * (n_a + 1.0) / 2.0);
+    if (tie_term == 0.0 && a.size() * b.size() <= kMaxExactU) {
+        // ways[k] counts the orderings of the two samples whose U is k, built one value at a time.
+        const size_t max_u = a.size() * b.size();
+        std::vector<std::vector<double>> ways(b.size() + 1, std::vector<double>(max_u + 1, 0.0));
+        for (auto& row : ways) {
+            row[0] = 1.0;
+        }
+        for (size_t m = 1; m <= a.size(); ++m) {
+            std::vector<std::vector<double>> next(b.size() + 1, std::vector<double>(max_u + 1));
+            next[0][0] = 1.0;
+            for (size_t k = 1; k <= b.size(); ++k) {
+                for (size_t value = 0; value <= m * k; ++value) {
+                    next[k][value] = next[k - 1][value] + ((value >= k) ? ways[k][value - k] : 0.0);
+                }
+            }
+            ways = std::move(next);
+        }
+        const std::vector<double>& counts = ways[b.size()];
+        double total = 0.0;
+        double at_most = 0.0;
+        double at_least = 0.0;
+        for (size_t value = 0; value <= max_u; ++value) {
+            total += counts[value];
+            at_most += (static_cast<double>(value) <= u) ? counts[value] : 0.0;
+            at_least += (static_cast<double>(value) >= u) ? counts[value] : 0.0;
+        }
+        return std::min(1.0, 2.0 * std::min(at_most, at_least) / total);
+    }
+    const double mean = n_a * n_b / 2.0;
+    const double variance = (n_a * n_b / 12.0) * ((n + 1.0) - (tie_term / (n * (n - 1.0))));
+    if (variance <= 0.0) {
+        return 1.0;
+    }
+    const double z = std::max(std::abs(u - mean) - 0.5, 0.0) / std::sqrt(variance);
+    return std::erfc(z / std::sqrt(2.0));
+}
+
+// Smallest two-sided p-value the exact test can reach with these repetition counts: the one of
+// samples that do not overlap at all.
+double min_p_value(size_t n_a, size_t n_b)
+{
+    double orderings = 1.0;
+    for (size_t k = 1; k <= n_b; ++k) {
+        orderings = orderings * static_cast<double>(n_a + k) / static_cast<double>(k);
+    }
+    return std::min(1.0, 2.0 / orderings);
+}
+
+struct Comparison {
+    std::string name;
+    // First error of the repetitions of each side, empty when none failed.
+    std::string baseline_error;
+    std::string contender_error;
+    size_t baseline_repetitions { 0 };
+    size_t contender_repetitions { 0 };
+    double baseline_ns { 0.0 };
+    double contender_ns { 0.0 };
+    double ratio { 1.0 };
+    double ratio_low { 1.0 };
+    double ratio_high { 1.0 };
+    double p_value { 1.0 };
+};
+
+// Percentile bootstrap of the ratio of the medians of the repetition medians, resampling whole
+// repetitions: the batch samples of one run are not independent of each other, which would make
+// any shift between runs look significant.
+void bootstrap(
+    const std::vector<double>& baseline,
+    const std::vector<double>& contender,
+    int resamples,
+    double alpha,
+    uint64_t seed,
+    Comparison& comparison)
+{
+    std::mt19937_64 generator { seed };
+    const auto resample = [&](const std::vector<double>& values) {
+        std::uniform_int_distribution<size_t> pick(0, values.size() - 1);
+        std::vector<double> drawn(values.size());
+        for (double& value : drawn) {
+            value = values[pick(generator)];
+        }
+        return median(std::move(drawn));
+    };
+    std::vector<double> ratios;
+    ratios.reserve(static_cast<size_t>(resamples));
+    for (int iteration = 0; iteration < resamples; ++iteration) {
+        const double baseline_median = resample(baseline);
+        const double contender_median = resample(contender);
+        if (baseline_median > 0.0) {
+            ratios.push_back(contender_median / baseline_median);
+        }
+    }
+    if (ratios.empty()) {
+        return;
+    }
+    std::ranges::sort(ratios);
+    const auto at = [&](double quantile) {
+        const auto index = static_cast<size_t>(quantile * static_cast<double>(ratios.size() - 1));
+        return ratios[index];
+    };
+    comparison.ratio_low = at(alpha / 2.0);
+    comparison.ratio_high = at(1.0 - (alpha / 2.0));
+}
+
+// The repetitions of one benchmark, in file order.
+struct RunGroup {
+    std::string_view name;
+    std::vector<const Run*> repetitions;
+};
+
+std::string first_error(const RunGroup& group)
+{
+    for (const Run* run : group.repetitions) {
+        if (!run->result.error.empty()) {
+            return run->result.error;
+        }
+    }
+    return {};
+}
+
+std::vector<RunGroup> group_runs(const uscope::BinaryResultFile& file)
+{
+    std::vector<RunGroup> groups;
+    std::unordered_map<std::string_view, size_t> positions;
+    for (const auto& run : file.runs()) {
+        const auto [it, inserted] = positions.try_emplace(run.result.name, groups.size());
+        if (inserted) {
+            groups.push_back({ .name = run.result.name, .repetitions = {} });
+        }
+        groups[it->second].repetitions.push_back(&run);
+    }
+    return groups;
+}
+
+Comparison compare(const RunGroup& baseline, const RunGroup& contender, const Options& options)
+{
+    const auto medians = [](const RunGroup& group) {
+        std::vector<double> values;
+        for (const Run* run : group.repetitions) {
+            if (run->result.iterations > 0) {
+                values.push_back(median_ns(*run));
+            }
+        }
+        return values;
+    };
+    const std::vector<double> baseline_values = medians(baseline);
+    const std::vector<double> contender_values = medians(contender);
+    Comparison comparison {
+        .name = std::string(baseline.name),
+        .baseline_error = first_error(baseline),
+        .contender_error = first_error(contender),
+        .baseline_repetitions = baseline_values.size(),
+        .contender_repetitions = contender_values.size(),
+    };
+    if (baseline_values.empty() || contender_values.empty()) {
+        return comparison;
+    }
+    comparison.baseline_ns = median(baseline_values);
+    comparison.contender_ns = median(contender_values);
+    if (comparison.baseline_ns > 0.0) {
+        comparison.ratio = comparison.contender_ns / comparison.baseline_ns;
+    }
+    comparison.p_value = mann_whitney_p_value(baseline_values, contender_values);
+    bootstrap(
+        baseline_values,
+        contender_values,
+        options.resamples,
+        options.alpha,
+        std::hash<std::string> {}(comparison.name),
+        comparison);
+    return comparison;
+}
+
+bool parse_number(std::string_view text, double& value)
+{
+    const auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+    return result.ec == std::errc {} && result.ptr == text.data() + text.size();
+}
+
+bool parse_number(std::string_view text, int& value)
+{
+    const auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+    return result.ec == std::errc {} && result.ptr == text.data() + text.size() && value > 0;
+}
+
+bool parse_options(int argc, char** argv, Options& options)
+{
+    std::vector<std::string_view> files;
+    for (int index = 1; index < argc; ++index) {
+        const std::string_view argument = argv[index];
+        const bool has_value = index + 1 < argc;
+        bool valid = true;
+        if (argument == "--threshold" && has_value) {
+            valid = parse_number(argv[++index], options.threshold);
+        } else if (argument == "--alpha" && has_value) {
+            valid = parse_number(argv[++index], options.alpha);
+        } else if (argument == "--resamples" && has_value) {
+            valid = parse_number(argv[++index], options.resamples);
+        } else if (argument == "--threads" && has_value) {
+            valid = parse_number(argv[++index], options.threads);
+        } else if (argument.starts_with("--")) {
+            valid = false;
+        } else {
+            files.push_back(argument);
+        }
+        if (!valid) {
+            std::fprintf(stderr, "uscope-compare: invalid argument %s\n", argv[index]);
+            return false;
+        }
+    }
+    if (files.size() != 2) {
+        return false;
+    }
+    options.baseline = files[0];
+    options.contender = files[1];
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!parse_options(argc, argv, options)) {
+        std::fprintf(
+            stderr,
+            "usage: uscope-compare [--threshold 0.05] [--alpha 0.05] [--resamples 1000] "
+            "[--threads N] baseline.bin contender.bin\n");
+        return 2;
+    }
+    const auto open = [](const std::string& path) {
+        auto file = uscope::BinaryResultFile::open(path);
+        if (!file) {
+            std::fprintf(stderr, "uscope-compare: cannot read %s\n", path.c_str());
+        }
+        return file;
+    };
+    const auto baseline = open(options.baseline);
+    const auto contender = open(options.contender);
+    if (!baseline || !contender) {
+        return 2;
+    }
+
+    std::unordered_map<std::string_view, RunGroup> contender_groups;
+    const std::vector<RunGroup> contender_order = group_runs(*contender);
+    for (const RunGroup& group : contender_order) {
+        contender_groups.emplace(group.name, group);
+    }
+    std::vector<std::pair<RunGroup, RunGroup>> pairs;
+    for (RunGroup& group : group_runs(*baseline)) {
+        if (const auto it = contender_groups.find(group.name); it != contender_groups.end()) {
+            pairs.emplace_back(std::move(group), std::move(it->second));
+            contender_groups.erase(it);
+        } else {
+            std::printf("only in baseline: %s\n", std::string(group.name).c_str());
+        }
+    }
+    // Failures of the contender that the baseline did not have fail the comparison.
+    int failures = 0;
+    for (const RunGroup& group : contender_order) {
+        if (contender_groups.contains(group.name)) {
+            std::printf("only in contender: %s\n", std::string(group.name).c_str());
+            if (const std::string error = first_error(group); !error.empty()) {
+                std::printf("  FAILED: %s\n", error.c_str());
+                ++failures;
+            }
+        }
+    }
+
+    // Benchmarks are handed out one at a time so a few with many samples do not stall a thread.
+    std::vector<Comparison> comparisons(pairs.size());
+    std::atomic<size_t> next { 0 };
+    const auto work = [&] {
+        for (size_t index = next++; index < pairs.size(); index = next++) {
+            comparisons[index] = compare(pairs[index].first, pairs[index].second, options);
+        }
+    };
+    {
+        std::vector<std::jthread> workers;
+        const auto worker_count = static_cast<size_t>(options.threads);
+        for (size_t worker = 1; worker < std::min(worker_count, pairs.size()); ++worker) {
+            workers.emplace_back(work);
+        }
+        work();
+    }
+
+    size_t name_width = std::string_view("Benchmark").size();
+    for (const Comparison& comparison : comparisons) {
+        name_width = std::max(name_width, comparison.name.size());
+    }
+    std::printf(
+        "%-*s %7s %14s %14s %9s %21s %10s\n",
+        static_cast<int>(name_width),
+        "Benchmark",
+        "Reps",
+        "Baseline ns",
+        "Contender ns",
+        "Delta",
+        "CI",
+        "p-value");
+    int regressions = 0;
+    int underpowered = 0;
+    for (const Comparison& comparison : comparisons) {
+        if (!comparison.baseline_error.empty() || !comparison.contender_error.empty()) {
+            const bool new_failure
+                = comparison.baseline_error.empty() && !comparison.contender_error.empty();
+            failures += new_failure ? 1 : 0;
+            std::printf(
+                "%-*s  FAILED in %s: %s\n",
+                static_cast<int>(name_width),
+                comparison.name.c_str(),
+                comparison.contender_error.empty() ? "baseline" : "contender",
+                comparison.contender_error.empty() ? comparison.baseline_error.c_str()
+                                                   : comparison.contender_error.c_str());
+            continue;
+        }
+        if (min_p_value(comparison.baseline_repetitions, comparison.contender_repetitions)
+            >= options.alpha) {
+            ++underpowered;
+        }
+        const bool significant = comparison.p_value < options.alpha
+            && (comparison.ratio_low > 1.0 || comparison.ratio_high < 1.0);
+        const char* verdict = "";
+        if (significant && comparison.ratio > 1.0 + options.threshold) {
+            verdict = "  REGRESSION";
+            ++regressions;
+        } else if (significant && comparison.ratio < 1.0 - options.threshold) {
+            verdict = "  improvement";
+        }
+        const std::string repetitions = std::to_string(comparison.baseline_repetitions) + "/"
+            + std::to_string(comparison.contender_repetitions);
+        std::printf(
+            "%-*s %7s %14.3f %14.3f %+8.2f%% [%+8.2f%%, %+8.2f%%] %10.3g%s\n",
+            static_cast<int>(name_width),
+            comparison.name.c_str(),
+            repetitions.c_str(),
+            comparison.baseline_ns,
+            comparison.contender_ns,
+            (comparison.ratio - 1.0) * 100.0,
+            (comparison.ratio_low - 1.0) * 100.0,
+            (comparison.ratio_high - 1.0) * 100.0,
+            comparison.p_value,
+            verdict);
+    }
+    if (underpowered > 0) {
+        std::printf(
+            "%d benchmarks have too few repetitions to be significant at alpha %.3g; record "
+            "both files with --repetitions 5 or more\n",
+            underpowered,
+            options.alpha);
+    }
+    if (failures > 0) {
+        std::printf("%d runs failed in the contender only\n", failures);
+    }
+    if (regressions > 0) {
+        std::printf(
+            "%d regressions past %.1f%% (alpha %.3g)\n",
+            regressions,
+            options.threshold * 100.0,
+            options.alpha);
+    }
+    if (failures > 0 || regressions > 0) {
+        return 1;
+    }
+    return 0;
+}
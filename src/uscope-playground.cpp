@@ -1,6 +1,14 @@
+#define USCOPE_TRACK_ALLOCATIONS
 #include "uscope.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <numeric>
+#include <random>
+#include <string>
 #include <thread>
+#include <vector>
 
 namespace {
 
@@ -12,15 +20,241 @@ void test_sleep_1ms(uscope::BenchmarkState& state)
         std::this_thread::sleep_for(1ms);
     }
 }
+USCOPE_BENCHMARK(test_sleep_1ms);
+
+std::atomic<int64_t> shared_counter { 0 };
+
+void test_contended_increment(uscope::BenchmarkState& state)
+{
+    while (state.keep_running()) {
+        shared_counter.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+USCOPE_BENCHMARK(test_contended_increment).threads({ 1, 2, 4 });
+
+// The runner subtracts the cost of an empty keep_running() loop, so the optimization barriers
+// should report zero time per iteration.
+void test_barrier_do_not_optimize(uscope::BenchmarkState& state)
+{
+    int64_t value = 0;
+    while (state.keep_running()) {
+        uscope::do_not_optimize(value);
+    }
+}
+USCOPE_BENCHMARK(test_barrier_do_not_optimize);
+
+void test_barrier_clobber_memory(uscope::BenchmarkState& state)
+{
+    while (state.keep_running()) {
+        uscope::clobber_memory();
+    }
+}
+USCOPE_BENCHMARK(test_barrier_clobber_memory);
+
+// Only the sort is timed, the shuffle rebuilding its input runs paused.
+void test_pause_sort_shuffled(uscope::BenchmarkState& state)
+{
+    std::vector<int> values(256);
+    std::iota(values.begin(), values.end(), 0);
+    std::mt19937 generator { 42 };
+    while (state.keep_running()) {
+        {
+            const uscope::ScopedPause pause(state);
+            std::ranges::shuffle(values, generator);
+        }
+        std::ranges::sort(values);
+        uscope::do_not_optimize(values.data());
+    }
+}
+USCOPE_BENCHMARK(test_pause_sort_shuffled);
+
+// A copy too long for the small string buffer allocates once per iteration.
+void test_alloc_string_copy(uscope::BenchmarkState& state)
+{
+    const std::string text(64, 'x');
+    while (state.keep_running()) {
+        std::string copy(text);
+        uscope::do_not_optimize(copy.data());
+    }
+}
+USCOPE_BENCHMARK(test_alloc_string_copy);
+
+void test_alloc_string_view(uscope::BenchmarkState& state)
+{
+    const std::string text(64, 'x');
+    while (state.keep_running()) {
+        std::string_view view(text);
+        uscope::do_not_optimize(view.data());
+    }
+}
+USCOPE_BENCHMARK(test_alloc_string_view).forbid_allocations();
+
+// A 50 us request keeps up with about 20k requests per second, past which requests queue and
+// the latency measured from their intended start grows without bound.
+void test_open_loop_request(uscope::BenchmarkState& state)
+{
+    while (state.keep_running()) {
+        const auto start = std::chrono::steady_clock::now();
+        while (std::chrono::steady_clock::now() - start < 50us) {
+        }
+    }
+}
+USCOPE_BENCHMARK(test_open_loop_request).rate_sweep(2'500, 40'000, 2);
+
+// Sweeps the size of the summed buffer across the cache levels.
+template<typename T>
+void test_args_sum(uscope::BenchmarkState& state)
+{
+    const std::vector<T> values(static_cast<size_t>(state.arg(0)) / sizeof(T), T { 1 });
+    while (state.keep_running()) {
+        T sum = std::accumulate(values.begin(), values.end(), T {});
+        uscope::do_not_optimize(sum);
+    }
+    state.set_bytes_processed(state.completed_iterations() * state.arg(0));
+    state.set_items_processed(state.completed_iterations() * static_cast<int64_t>(values.size()));
+}
+USCOPE_BENCHMARK_TEMPLATE(test_args_sum, int32_t, double)
+    .range(64, 64 << 10)
+    .arg_names({ "bytes" })
+    .complexity(uscope::Complexity::Auto);
+
+// The same 4 MiB sum, once with the buffer left in the cache by warm-up iterations and once with
+// its lines flushed before every iteration.
+void sum_cache_buffer(uscope::BenchmarkState& state)
+{
+    static const std::vector<int64_t> values(size_t { 1 } << 19, 1);
+    state.add_flush_region(values.data(), values.size() * sizeof(int64_t));
+    while (state.keep_running()) {
+        uscope::do_not_optimize(std::accumulate(values.begin(), values.end(), int64_t { 0 }));
+    }
+}
+
+void test_cache_sum_warm(uscope::BenchmarkState& state)
+{
+    sum_cache_buffer(state);
+}
+USCOPE_BENCHMARK(test_cache_sum_warm).cache_mode(uscope::CacheMode::Warm);
+
+void test_cache_sum_cold(uscope::BenchmarkState& state)
+{
+    sum_cache_buffer(state);
+}
+USCOPE_BENCHMARK(test_cache_sum_cold).cache_mode(uscope::CacheMode::Cold);
+
+// Both searches share one sorted input per size, built by whichever runs first.
+struct SortedInput {
+    std::shared_ptr<const std::vector<int64_t>> values;
+
+    void setup(uscope::BenchmarkState& state)
+    {
+        values = state.shared_data<SortedInput>([](std::span<const uscope::Argument> arguments) {
+            std::vector<int64_t> sorted(static_cast<size_t>(arguments[0]));
+            std::iota(sorted.begin(), sorted.end(), 0);
+            return sorted;
+        });
+    }
+
+    void teardown(uscope::BenchmarkState&)
+    {
+        values.reset();
+    }
+};
+
+void test_fixture_binary_search(SortedInput& input, uscope::BenchmarkState& state)
+{
+    int64_t key = 0;
+    while (state.keep_running()) {
+        uscope::do_not_optimize(std::ranges::binary_search(*input.values, key));
+        key = (key + 7919) % state.arg(0);
+    }
+}
+USCOPE_BENCHMARK_FIXTURE(SortedInput, test_fixture_binary_search).range(1 << 10, 1 << 15, 32);
+
+void test_fixture_linear_search(SortedInput& input, uscope::BenchmarkState& state)
+{
+    int64_t key = 0;
+    while (state.keep_running()) {
+        uscope::do_not_optimize(std::ranges::find(*input.values, key));
+        key = (key + 7919) % state.arg(0);
+    }
+}
+USCOPE_BENCHMARK_FIXTURE(SortedInput, test_fixture_linear_search).range(1 << 10, 1 << 15, 32);
+
+uscope::Task<int64_t> increment(int64_t value)
+{
+    co_return value + 1;
+}
+
+// A coroutine frame allocation and a symmetric transfer per iteration.
+uscope::Task<> test_async_call(uscope::BenchmarkState& state)
+{
+    int64_t value = 0;
+    while (state.keep_running()) {
+        value = co_await increment(value);
+        uscope::do_not_optimize(value);
+    }
+}
+USCOPE_BENCHMARK_ASYNC(test_async_call);
+
+// A suspension and a resumption through the executor per iteration.
+uscope::Task<> test_async_yield(uscope::BenchmarkState& state)
+{
+    while (state.keep_running()) {
+        co_await uscope::Executor::current().yield();
+    }
+}
+USCOPE_BENCHMARK_ASYNC(test_async_yield);
+
+constexpr uscope::StaticConfig kStaticEmptyLoop { .batch_size = 10'000 };
+
+// The harness adds nothing to the loop body, which is a decrement and a branch around the barrier
+// once optimized, with the batch ends outside of it. CheckLoopDisassembly.cmake verifies it.
+void test_static_empty_loop(uscope::StaticState<kStaticEmptyLoop>& state)
+{
+    for (auto iteration : state) {
+        uscope::do_not_optimize(iteration);
+    }
+}
+USCOPE_BENCHMARK_STATIC(test_static_empty_loop, kStaticEmptyLoop);
 
 } // namespace
 
-int main()
+// The demonstration runners below, unless flags select benchmarks as uscope::main() does.
+int main(int argc, char** argv)
 {
+    if (argc > 1) {
+        return uscope::main(argc, argv);
+    }
+
     uscope::BenchmarkRunner runner(
         uscope::Config {
             .iteration_count = 10,
+            .filter = "^test_(sleep|contended|cache)",
+        });
+    runner.run_registered_benchmarks();
+
+    uscope::BenchmarkRunner barrier_runner(
+        uscope::Config {
+            .batch_size = 10'000,
+            .min_time = 100ms,
+            .filter = "^test_(barrier|pause|alloc|open_loop|args|fixture|async|static)_",
+        });
+    barrier_runner.run_registered_benchmarks();
+
+    uscope::BenchmarkRunner repetitions_runner(
+        uscope::Config {
+            .min_time = 20ms,
+            .filter = "^test_pause_",
+            .repetitions = 5,
+            .interleave_repetitions = true,
+        });
+    repetitions_runner.run_registered_benchmarks();
+
+    uscope::BenchmarkRunner isolated_runner(
+        uscope::Config {
+            .min_time = 20ms,
+            .filter = "^test_alloc_",
+            .isolate = true,
         });
-    runner.add_benchmark("test_sleep_1ms", &test_sleep_1ms);
-    runner.run_all_benchmarks();
+    isolated_runner.run_registered_benchmarks();
 }
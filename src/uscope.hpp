@@ -1,142 +1,7502 @@
 #ifndef USCOPE_HPP_
 #define USCOPE_HPP_
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <barrier>
+#include <bit>
+#include <charconv>
 #include <chrono>
+#include <cmath>
 #include <concepts>
+#include <cerrno>
+#include <coroutine>
+#include <cstddef>
 #include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <forward_list>
 #include <functional>
+#include <initializer_list>
 #include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <random>
+#include <regex>
+#include <span>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
 #include <type_traits>
+#include <typeindex>
 #include <utility>
+#include <vector>
+
+#if defined(_MSC_VER)
+#define USCOPE_NOINLINE __declspec(noinline)
+#define USCOPE_ALWAYS_INLINE __forceinline
+#else
+#define USCOPE_NOINLINE __attribute__((noinline))
+#define USCOPE_ALWAYS_INLINE inline __attribute__((always_inline))
+#endif
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define USCOPE_ARCH_X86 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define USCOPE_ARCH_AARCH64 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__linux__)
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <link.h>
+#include <linux/mempolicy.h>
+#include <linux/perf_event.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#if __has_include(<cxxabi.h>)
+#include <cxxabi.h>
+#define USCOPE_HAS_CXXABI 1
+#else
+#define USCOPE_HAS_CXXABI 0
+#endif
+
+// Binary results are zstd-compressed on request when USCOPE_USE_ZSTD is defined and libzstd linked.
+#if defined(USCOPE_USE_ZSTD) && __has_include(<zstd.h>)
+#include <zstd.h>
+#define USCOPE_HAS_ZSTD 1
+#else
+#define USCOPE_HAS_ZSTD 0
+#endif
 
 namespace uscope {
 
 using Iteration = int64_t;
+using Argument = int64_t;
 
-class BenchmarkState {
-public:
-    explicit BenchmarkState(Iteration iteration_count)
-        : total_iterations_(iteration_count)
-        , remaining_iterations_(iteration_count)
+// do_not_optimize(value) makes the compiler assume value is read, and written when it is a
+// non-const lvalue, without emitting any instruction. Values that fit in a register are kept there
+// rather than being spilled to memory. clobber_memory() makes it assume any memory may have been
+// read or written, which forces pending stores to be emitted.
+#if defined(__clang__)
+template<typename T>
+USCOPE_ALWAYS_INLINE void do_not_optimize(const T& value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+template<typename T>
+USCOPE_ALWAYS_INLINE void do_not_optimize(T& value)
+{
+    asm volatile("" : "+r,m"(value) : : "memory");
+}
+
+template<typename T>
+USCOPE_ALWAYS_INLINE void do_not_optimize(T&& value)
+{
+    asm volatile("" : "+r,m"(value) : : "memory");
+}
+
+USCOPE_ALWAYS_INLINE void clobber_memory()
+{
+    asm volatile("" : : : "memory");
+}
+#elif defined(__GNUC__)
+// GCC picks the memory alternative of "r,m" for lvalues, so register-sized trivially copyable
+// values get a register-only constraint.
+template<typename T>
+inline constexpr bool fits_in_register_v
+    = std::is_trivially_copyable_v<T> && (sizeof(T) <= sizeof(void*));
+
+template<typename T>
+USCOPE_ALWAYS_INLINE void do_not_optimize(const T& value)
+{
+    if constexpr (fits_in_register_v<T>) {
+        asm volatile("" : : "r"(value) : "memory");
+    } else {
+        asm volatile("" : : "m"(value) : "memory");
+    }
+}
+
+template<typename T>
+USCOPE_ALWAYS_INLINE void do_not_optimize(T& value)
+{
+    if constexpr (fits_in_register_v<T>) {
+        asm volatile("" : "+r"(value) : : "memory");
+    } else {
+        asm volatile("" : "+m"(value) : : "memory");
+    }
+}
+
+template<typename T>
+USCOPE_ALWAYS_INLINE void do_not_optimize(T&& value)
+{
+    do_not_optimize(value);
+}
+
+USCOPE_ALWAYS_INLINE void clobber_memory()
+{
+    asm volatile("" : : : "memory");
+}
+#elif defined(_MSC_VER)
+namespace detail {
+
+// Out of line so the compiler cannot see that the pointer is unused.
+USCOPE_NOINLINE inline void use_char_pointer(const volatile char* /*pointer*/)
+{
+}
+
+} // namespace detail
+
+// MSVC has no inline assembly on x64 and ARM64, so the value is escaped through its address and
+// a compiler barrier.
+template<typename T>
+USCOPE_ALWAYS_INLINE void do_not_optimize(T&& value)
+{
+    detail::use_char_pointer(&reinterpret_cast<const volatile char&>(value));
+    _ReadWriteBarrier();
+}
+
+USCOPE_ALWAYS_INLINE void clobber_memory()
+{
+    _ReadWriteBarrier();
+}
+#endif
+
+struct SteadyClock {
+    static constexpr std::string_view name = "steady_clock";
+    static constexpr bool available = true;
+
+    static USCOPE_ALWAYS_INLINE int64_t start() noexcept
     {
-        iterations_time_.reserve(total_iterations_);
+        return std::chrono::steady_clock::now().time_since_epoch().count();
     }
 
-    [[nodiscard]] bool keep_running()
+    static USCOPE_ALWAYS_INLINE int64_t stop() noexcept
     {
-        switch (state_) {
-        case State::Finished:
-        case State::Skipped: {
-            return false;
-        }
-        case State::NotStarted: {
-            state_ = State::Started;
-        } break;
-        case State::Started: {
-            end_ = std::chrono::steady_clock::now();
-            int64_t elapsed
-                = std::chrono::duration_cast<std::chrono::nanoseconds>(end_ - begin_).count();
-            iterations_time_.push_back(elapsed);
-        } break;
-        }
+        return std::chrono::steady_clock::now().time_since_epoch().count();
+    }
+};
 
-        bool should_run = remaining_iterations_-- > 0;
-        if (!should_run) {
-            state_ = State::Finished;
-        }
-        begin_ = std::chrono::steady_clock::now();
-        return should_run;
+#if defined(USCOPE_ARCH_X86)
+// The lfence after rdtsc keeps the measured code from starting before the counter is read, and
+// rdtscp followed by lfence keeps it from being read before the measured code has retired.
+struct TscClock {
+    static constexpr std::string_view name = "rdtsc";
+    static constexpr bool available = true;
+
+    static USCOPE_ALWAYS_INLINE int64_t start() noexcept
+    {
+        _mm_lfence();
+        const auto ticks = static_cast<int64_t>(__rdtsc());
+        _mm_lfence();
+        return ticks;
     }
 
-    [[nodiscard]] Iteration remaining_iterations() const
+    static USCOPE_ALWAYS_INLINE int64_t stop() noexcept
     {
-        return remaining_iterations_;
+        unsigned int aux = 0;
+        const auto ticks = static_cast<int64_t>(__rdtscp(&aux));
+        _mm_lfence();
+        return ticks;
+    }
+};
+using CycleCounterClock = TscClock;
+#elif defined(USCOPE_ARCH_AARCH64)
+// The isb keeps the counter read from being speculated ahead of the surrounding instructions.
+struct CntvctClock {
+    static constexpr std::string_view name = "cntvct_el0";
+    static constexpr bool available = true;
+
+    static USCOPE_ALWAYS_INLINE int64_t start() noexcept
+    {
+        return read();
+    }
+
+    static USCOPE_ALWAYS_INLINE int64_t stop() noexcept
+    {
+        return read();
     }
 
 private:
-    enum class State : uint8_t {
-        NotStarted,
-        Started,
-        Finished,
-        Skipped,
-    };
+    static USCOPE_ALWAYS_INLINE int64_t read() noexcept
+    {
+#if defined(_MSC_VER)
+        __isb(_ARM64_BARRIER_SY);
+        const auto ticks = static_cast<int64_t>(_ReadStatusReg(ARM64_CNTVCT));
+        __isb(_ARM64_BARRIER_SY);
+#else
+        uint64_t ticks = 0;
+        asm volatile("isb\n\tmrs %0, cntvct_el0\n\tisb" : "=r"(ticks) : : "memory");
+#endif
+        return static_cast<int64_t>(ticks);
+    }
+};
+using CycleCounterClock = CntvctClock;
+#else
+struct CycleCounterClock : SteadyClock {
+    static constexpr bool available = false;
+};
+#endif
 
-    Iteration total_iterations_;
-    Iteration remaining_iterations_;
-    State state_ { State::NotStarted };
-    std::chrono::steady_clock::time_point begin_;
-    std::chrono::steady_clock::time_point end_;
-    std::vector<int64_t> iterations_time_;
+enum class ClockSource : uint8_t {
+    Steady,
+    CycleCounter,
 };
 
-template<typename Fn, typename... Args>
-concept BenchmarkFunction = std::invocable<Fn, BenchmarkState&>
-    && std::is_void_v<typename std::invoke_result_t<Fn, BenchmarkState&>>;
+struct ClockInfo {
+    std::string_view name;
+    double ns_per_tick;
+    double resolution_ns;
+    double overhead_ns;
+};
 
-class Benchmark {
-public:
-    template<BenchmarkFunction Fn>
-    Benchmark(const std::string& name, Fn&& function)
-        : name_(name)
-        , function_(std::forward<Fn>(function))
+namespace detail {
+
+template<typename Clock>
+double calibrate_ns_per_tick()
+{
+    if constexpr (std::is_same_v<Clock, SteadyClock>) {
+        using Period = std::chrono::steady_clock::period;
+        return 1e9 * static_cast<double>(Period::num) / static_cast<double>(Period::den);
+    } else {
+        static constexpr auto kCalibrationTime = std::chrono::milliseconds(20);
+        const auto steady_begin = std::chrono::steady_clock::now();
+        const int64_t ticks_begin = Clock::start();
+        auto steady_end = steady_begin;
+        while (steady_end - steady_begin < kCalibrationTime) {
+            steady_end = std::chrono::steady_clock::now();
+        }
+        const int64_t ticks_end = Clock::stop();
+        const auto elapsed_ns
+            = std::chrono::duration_cast<std::chrono::nanoseconds>(steady_end - steady_begin);
+        return static_cast<double>(elapsed_ns.count())
+            / static_cast<double>(std::max<int64_t>(ticks_end - ticks_begin, 1));
+    }
+}
+
+template<typename Clock>
+ClockInfo measure_clock()
+{
+    static constexpr int kReads = 1 << 16;
+
+    ClockInfo info { Clock::name, calibrate_ns_per_tick<Clock>(), 0.0, 0.0 };
+
+    int64_t resolution = std::numeric_limits<int64_t>::max();
+    int64_t previous = Clock::start();
+    for (int i = 0; i < kReads; ++i) {
+        const int64_t current = Clock::start();
+        if (current > previous) {
+            resolution = std::min(resolution, current - previous);
+        }
+        previous = current;
+    }
+    info.resolution_ns = static_cast<double>(resolution) * info.ns_per_tick;
+
+    const int64_t begin = Clock::start();
+    for (int i = 0; i < kReads; ++i) {
+        static_cast<void>(Clock::stop());
+    }
+    const int64_t end = Clock::stop();
+    info.overhead_ns = static_cast<double>(end - begin) * info.ns_per_tick / kReads;
+    return info;
+}
+
+} // namespace detail
+
+// Calibrated against steady_clock the first time each clock is requested.
+inline const ClockInfo& clock_info(ClockSource source)
+{
+    if (source == ClockSource::CycleCounter && CycleCounterClock::available) {
+        static const ClockInfo info = detail::measure_clock<CycleCounterClock>();
+        return info;
+    }
+    static const ClockInfo info = detail::measure_clock<SteadyClock>();
+    return info;
+}
+
+// Streaming keeps constant-memory statistics and a histogram of the samples. Raw additionally keeps
+// every sample, which costs memory proportional to the number of batches.
+enum class SampleStorage : uint8_t {
+    Streaming,
+    Raw,
+};
+
+// How samples are classified as mild or severe outliers, see classify_outliers().
+enum class OutlierMethod : uint8_t {
+    // Tukey's fences at 1.5 and 3 interquartile ranges beyond the quartiles, as criterion does.
+    Iqr,
+    // 3 and 5 scaled median absolute deviations away from the median.
+    Mad,
+};
+
+// A perf_event_open event type and config, named for the report. Only supported on Linux.
+struct PerfCounter {
+    std::string name;
+    uint32_t type;
+    uint64_t config;
+
+#if defined(__linux__)
+    static PerfCounter cycles()
     {
+        return { "cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES };
     }
 
-    void execute(BenchmarkState& state)
+    static PerfCounter instructions()
     {
-        function_(state);
+        return { "instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS };
     }
 
-private:
-    std::string name_;
-    std::function<void(BenchmarkState&)> function_;
+    static PerfCounter branch_misses()
+    {
+        return { "branch-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES };
+    }
+
+    static PerfCounter l1d_misses()
+    {
+        return {
+            "L1D-misses",
+            PERF_TYPE_HW_CACHE,
+            PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+        };
+    }
+
+    static PerfCounter llc_misses()
+    {
+        return {
+            "LLC-misses",
+            PERF_TYPE_HW_CACHE,
+            PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+        };
+    }
+
+    static PerfCounter page_faults()
+    {
+        return { "page-faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS };
+    }
+
+    static PerfCounter context_switches()
+    {
+        return { "context-switches", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES };
+    }
+
+    // Model-specific event, encoded as for perf stat -e r<config>.
+    static PerfCounter raw(std::string name, uint64_t config)
+    {
+        return { std::move(name), PERF_TYPE_RAW, config };
+    }
+#endif
+};
+
+enum class NumaPolicy : uint8_t {
+    Default,
+    Local,
+    Preferred,
+    Bind,
+    Interleave,
+};
+
+// Where the threads of a benchmark run and allocate, applied by the runner around
+// Benchmark::execute() and restored afterwards. A single thread is restricted to the whole cpus
+// set, while the threads of a multi-threaded run are each pinned to one of its CPUs in turn. The
+// memory policy applies to numa_nodes, and a non-zero realtime_priority switches the threads to
+// SCHED_FIFO where the process is permitted to. Only supported on Linux, where failures are
+// reported on stderr without stopping the run.
+struct Placement {
+    std::vector<int> cpus {};
+    NumaPolicy numa_policy { NumaPolicy::Default };
+    std::vector<int> numa_nodes {};
+    int realtime_priority { 0 };
+};
+
+// Intended start times of the iterations of an open-loop run.
+enum class Arrivals : uint8_t {
+    // Evenly spaced at the rate.
+    Constant,
+    // Exponentially distributed gaps averaging the rate, as independent clients would send.
+    Poisson,
 };
 
+// State of the caches when the timed batches start.
+enum class CacheMode : uint8_t {
+    // Whatever calibration and the previous iterations left behind.
+    Default,
+    // Config::warmup_iterations run untimed first, on every thread, and are discarded.
+    Warm,
+    // The last level cache is evicted before every batch, outside the measurement: the lines of
+    // the regions given to BenchmarkState::add_flush_region() if any, the whole cache otherwise.
+    // Batches of a single iteration give first-touch numbers for every iteration.
+    Cold,
+};
+
+// With an iteration_count of 0, the runner calibrates the iteration count of each benchmark by
+// growing it geometrically until the timed region lasts at least min_time and, when
+// target_relative_error is non-zero, until the relative standard error of the mean drops below it.
+// Calibration never grows past max_iterations, and stops growing once the next calibration step
+// plus the measurement run are predicted to push the time spent on the benchmark past max_time.
 struct Config {
-    Iteration iteration_count;
+    Iteration iteration_count { 0 };
+    Iteration batch_size { 1 };
+    std::chrono::nanoseconds min_time { std::chrono::milliseconds(500) };
+    std::chrono::nanoseconds max_time { std::chrono::seconds(5) };
+    double target_relative_error { 0.0 };
+    Iteration max_iterations { 1'000'000'000 };
+    ClockSource clock { ClockSource::Steady };
+    SampleStorage sample_storage { SampleStorage::Streaming };
+    // Subtract the empty keep_running() loop cost from the reported per-iteration time.
+    bool subtract_overhead { true };
+    // Results whose raw per-iteration time is below this multiple of the empty loop cost are
+    // flagged as unreliable.
+    double unreliable_overhead_ratio { 4.0 };
+    // ECMAScript regular expression searched in the family name of each benchmark, which selects
+    // all of its runs, and else in the full name of each run; empty selects every benchmark.
+    std::string filter {};
+    // Each benchmark is run once per thread count, every thread with its own BenchmarkState and
+    // iteration_count iterations.
+    std::vector<int> threads { 1 };
+    Placement placement {};
+    // Counted over the same windows as the clock, in a single group so they are scheduled
+    // together. Unavailable events are reported on stderr and the run goes on without counters.
+    std::vector<PerfCounter> perf_counters {};
+    // Each run is repeated with the iteration count of its first repetition, then followed by the
+    // mean, median, stddev, cv and min of its repetitions.
+    int repetitions { 1 };
+    // Runs repetition r of every benchmark before repetition r + 1 of any, so that slow frequency
+    // or thermal drifts spread over all the benchmarks instead of biasing the last ones.
+    bool interleave_repetitions { false };
+    OutlierMethod outlier_method { OutlierMethod::Iqr };
+    // Overridden per benchmark by Benchmark::cache_mode().
+    CacheMode cache_mode { CacheMode::Default };
+    Iteration warmup_iterations { 100 };
+    // Iterations per second over all threads of an open-loop run, 0 for the closed loop where an
+    // iteration starts when the previous one ends. The runner sets them for each run from
+    // Benchmark::open_loop() and Benchmark::rate_sweep().
+    double open_loop_rate { 0.0 };
+    Arrivals arrivals { Arrivals::Constant };
+    // Runs the single-threaded runs of the suite concurrently, one worker pinned to each of
+    // suite_cpus, or to the isolated CPUs the process may use, or else to every CPU it may use,
+    // never two on SMT siblings. Each idle worker takes the longest run left, as estimated from
+    // suite_estimates, or the next one in registration order without it, and results are still
+    // reported in registration order once all ran.
+    // Multi-threaded runs follow on their own, as without parallel_suite. Interleaving
+    // repetitions does not apply.
+    bool parallel_suite { false };
+    std::vector<int> suite_cpus {};
+    // Binary result file of a previous run, whose durations estimate those of the runs with the
+    // same name for scheduling the parallel suite. Without it every estimate is 0 and runs are
+    // taken in registration order.
+    std::string suite_estimates {};
+    // Runs each run, calibration and repetitions included, in a child process forked for it and
+    // sending its results back through shared memory, so that neither a crash or a hang nor the
+    // heap and caches left by one run reach the others. A child killed by a signal, exiting with
+    // an error or still running after isolation_timeout gives a failed result. Linux only. Takes
+    // precedence over parallel_suite and interleave_repetitions, and data built with
+    // BenchmarkState::shared_data() is no longer shared between runs.
+    bool isolate { false };
+    std::chrono::nanoseconds isolation_timeout { std::chrono::minutes(5) };
+    // Refuses to run anything, listing the warnings of the environment probe on stderr, when it
+    // found any. See Environment.
+    bool strict_environment { false };
+    // Appends the call stacks sampled in the timed region of every run, calibration aside, to this
+    // file as folded stacks rooted at the run name, one line per distinct stack with its count, as
+    // flamegraph.pl and speedscope read them. Linux only, see detail::SamplingProfiler. Runs of
+    // the parallel suite are profiled on their own workers and appended one at a time.
+    std::string profile {};
 };
 
-template<std::integral Integer>
-static inline size_t count_digits(Integer n)
+// Settings of a benchmark fixed at compile time, see USCOPE_BENCHMARK_STATIC and StaticState. A
+// structural subset of Config so it can be a template argument; an iteration_count of 0 keeps the
+// calibration of the runner.
+struct StaticConfig {
+    Iteration iteration_count { 0 };
+    Iteration batch_size { 1 };
+    ClockSource clock { ClockSource::Steady };
+};
+
+namespace detail {
+
+// Clock and batch size BenchmarkState starts its batches with: its own, or constants.
+struct BatchTiming {
+    bool constant { false };
+    ClockSource clock { ClockSource::Steady };
+    Iteration batch_size { 1 };
+};
+
+constexpr BatchTiming batch_timing(StaticConfig options)
 {
-    size_t result = 1;
-    if (n < 0) {
-        n = (n == std::numeric_limits<Integer>::min()) ? std::numeric_limits<Integer>::max() : -n;
+    const bool cycle_counter
+        = options.clock == ClockSource::CycleCounter && CycleCounterClock::available;
+    return BatchTiming {
+        .constant = true,
+        .clock = cycle_counter ? ClockSource::CycleCounter : ClockSource::Steady,
+        .batch_size = options.batch_size,
+    };
+}
+
+} // namespace detail
+
+struct Sample {
+    double elapsed_ns;
+    Iteration iterations;
+
+    [[nodiscard]] double per_iteration_ns() const
+    {
+        return elapsed_ns / static_cast<double>(iterations);
     }
-    while (n > 9) {
-        n /= 10;
-        result++;
+};
+
+// User counter of a benchmark, set on its state. The values set by the threads of a run are summed,
+// then the flags turn the sum into the reported value.
+struct Counter {
+    enum Flags : uint32_t {
+        Default = 0,
+        // Divided by the timed seconds of a thread.
+        Rate = 1U << 0,
+        // Divided by the number of threads.
+        AverageThreads = 1U << 1,
+        // Divided by the number of iterations.
+        PerIteration = 1U << 2,
+        // Inverted last, turning a rate into seconds per unit for example.
+        Invert = 1U << 3,
+    };
+
+    // Base of the prefixes the value is printed with, k and Ki for example.
+    enum class OneK : uint8_t {
+        Is1000,
+        Is1024,
+    };
+
+    double value { 0.0 };
+    Flags flags { Default };
+    OneK one_k { OneK::Is1000 };
+};
+
+constexpr Counter::Flags operator|(Counter::Flags lhs, Counter::Flags rhs)
+{
+    return static_cast<Counter::Flags>(static_cast<uint32_t>(lhs) | static_cast<uint32_t>(rhs));
+}
+
+namespace detail {
+
+// kilo, Mega, Giga, Tera, Peta, Exa, Zetta, Yotta.
+constexpr std::array<std::string_view, 8> kBigSIUnits { "k", "M", "G", "T", "P", "E", "Z", "Y" };
+// Kibi, Mebi, Gibi, Tebi, Pebi, Exbi, Zebi, Yobi.
+constexpr std::array<std::string_view, 8> kBigIECUnits {
+    "Ki", "Mi", "Gi", "Ti", "Pi", "Ei", "Zi", "Yi",
+};
+// milli, micro, nano, pico, femto, atto, zepto, yocto.
+constexpr std::array<std::string_view, 8> kSmallSIUnits { "m", "u", "n", "p", "f", "a", "z", "y" };
+
+inline Counter
+finalize_counter(Counter counter, double thread_seconds, int threads, Iteration iterations)
+{
+    if ((counter.flags & Counter::Rate) != 0) {
+        counter.value = (thread_seconds > 0.0) ? counter.value / thread_seconds : 0.0;
     }
-    return result;
+    if ((counter.flags & Counter::AverageThreads) != 0 && threads > 0) {
+        counter.value /= threads;
+    }
+    if ((counter.flags & Counter::PerIteration) != 0 && iterations > 0) {
+        counter.value /= static_cast<double>(iterations);
+    }
+    if ((counter.flags & Counter::Invert) != 0) {
+        counter.value = (counter.value != 0.0) ? 1.0 / counter.value : 0.0;
+    }
+    return counter;
 }
 
-class BenchmarkRunner {
+} // namespace detail
+
+// Writes value scaled to an SI or IEC prefix, as in 12.3Gi, to [first, last) without allocating and
+// returns the end of the written characters. Values below precision digits are printed as they are.
+inline char* to_chars_human_readable(
+    char* first,
+    char* last,
+    double value,
+    Counter::OneK one_k = Counter::OneK::Is1000,
+    int precision = 1)
+{
+    const bool iec = one_k == Counter::OneK::Is1024;
+    const double one_k_value = iec ? 1024.0 : 1000.0;
+    // Thresholds never exclude values that cannot be rendered in precision digits.
+    const double adjusted_threshold = std::max(1.0, 1.0 / std::pow(10.0, precision));
+    const double big_threshold = (adjusted_threshold * one_k_value) - 1;
+    const double small_threshold = adjusted_threshold;
+    // Values in ]simple_threshold, small_threshold[ are printed as they are.
+    static constexpr double kSimpleThreshold = 0.01;
+
+    const double magnitude = std::abs(value);
+    double mantissa = magnitude;
+    std::string_view prefix;
+    if (magnitude > big_threshold) {
+        double scaled = magnitude;
+        for (size_t index = 0; index < detail::kBigSIUnits.size(); ++index) {
+            scaled /= one_k_value;
+            if (scaled <= big_threshold) {
+                mantissa = scaled;
+                prefix = iec ? detail::kBigIECUnits[index] : detail::kBigSIUnits[index];
+                break;
+            }
+        }
+    } else if (magnitude < small_threshold && magnitude < kSimpleThreshold && magnitude > 0.0) {
+        double scaled = magnitude;
+        for (const std::string_view unit : detail::kSmallSIUnits) {
+            scaled *= one_k_value;
+            if (scaled >= small_threshold) {
+                mantissa = scaled;
+                prefix = unit;
+                break;
+            }
+        }
+    }
+    // Six significant digits, as an ostream prints by default.
+    const auto [end, error] = std::to_chars(
+        first,
+        last,
+        std::signbit(value) ? -mantissa : mantissa,
+        std::chars_format::general,
+        6);
+    if (error != std::errc {} || static_cast<size_t>(last - end) < prefix.size()) {
+        return first;
+    }
+    return std::copy(prefix.begin(), prefix.end(), end);
+}
+
+inline std::string human_readable_number(double value, Counter::OneK one_k = Counter::OneK::Is1000)
+{
+    std::array<char, 64> buffer {};
+    return std::string(
+        buffer.data(),
+        to_chars_human_readable(buffer.data(), buffer.data() + buffer.size(), value, one_k));
+}
+
+// "0-3,8" style list.
+inline std::string format_cpu_list(const std::vector<int>& cpus)
+{
+    std::string list;
+    for (size_t first = 0; first < cpus.size();) {
+        size_t last = first;
+        while (last + 1 < cpus.size() && cpus[last + 1] == cpus[last] + 1) {
+            ++last;
+        }
+        if (!list.empty()) {
+            list += ',';
+        }
+        list += std::to_string(cpus[first]);
+        if (last > first) {
+            list += '-';
+            list += std::to_string(cpus[last]);
+        }
+        first = last + 1;
+    }
+    return list;
+}
+
+// Inverse of format_cpu_list(), ignoring malformed entries.
+inline std::vector<int> parse_cpu_list(std::string_view list)
+{
+    std::vector<int> cpus;
+    while (!list.empty()) {
+        const std::string_view entry = list.substr(0, list.find(','));
+        list.remove_prefix(std::min(entry.size() + 1, list.size()));
+        int first = 0;
+        int last = 0;
+        const char* const entry_end = entry.data() + entry.size();
+        const auto [end, error] = std::from_chars(entry.data(), entry_end, first);
+        if (error != std::errc {}) {
+            continue;
+        }
+        last = first;
+        if (end != entry_end
+            && (*end != '-' || std::from_chars(end + 1, entry_end, last).ec != std::errc {})) {
+            continue;
+        }
+        for (int cpu = first; cpu <= last; ++cpu) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+namespace detail {
+
+#if defined(__linux__)
+class ScopedPlacement {
 public:
-    explicit BenchmarkRunner(const Config& config)
-        : config_(config)
+    ScopedPlacement(const Placement& placement, int thread_index, int thread_count)
     {
+        if (!placement.cpus.empty()) {
+            apply_affinity(placement, thread_index, thread_count);
+        }
+        if (placement.numa_policy != NumaPolicy::Default || !placement.numa_nodes.empty()) {
+            apply_memory_policy(placement);
+        }
+        if (placement.realtime_priority > 0) {
+            apply_priority(placement.realtime_priority);
+        }
     }
 
-    template<BenchmarkFunction Fn>
-    void add_benchmark(const std::string& name, Fn&& function)
+    ScopedPlacement(const ScopedPlacement&) = delete;
+    ScopedPlacement& operator=(const ScopedPlacement&) = delete;
+
+    ~ScopedPlacement()
     {
-        benchmarks_.emplace_back(Benchmark { name, std::forward<Fn>(function) });
+        if (restore_priority_) {
+            pthread_setschedparam(pthread_self(), previous_policy_, &previous_param_);
+        }
+        if (restore_memory_policy_) {
+            syscall(
+                SYS_set_mempolicy,
+                previous_memory_policy_,
+                previous_nodes_.data(),
+                kMaxNodes + 1);
+        }
+        if (restore_affinity_) {
+            sched_setaffinity(0, sizeof(previous_affinity_), &previous_affinity_);
+        }
     }
 
-    void run_all_benchmarks()
+    // CPUs the calling thread is allowed to run on.
+    static std::vector<int> effective_cpus()
     {
-        for (auto& benchmark : benchmarks_) {
-            BenchmarkState state(config_.iteration_count);
-            benchmark.execute(state);
+        std::vector<int> cpus;
+        cpu_set_t affinity;
+        CPU_ZERO(&affinity);
+        if (sched_getaffinity(0, sizeof(affinity), &affinity) == 0) {
+            for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+                if (CPU_ISSET(cpu, &affinity)) {
+                    cpus.push_back(cpu);
+                }
+            }
         }
+        return cpus;
     }
 
 private:
-    Config config_;
-    std::vector<Benchmark> benchmarks_;
+    static constexpr unsigned long kMaxNodes = 1024;
+    static constexpr size_t kBitsPerWord = 8 * sizeof(unsigned long);
+    using NodeMask = std::array<unsigned long, kMaxNodes / kBitsPerWord>;
+
+    // Reported once per process, as calibration runs a benchmark many times.
+    static void warn(const char* what, std::atomic_flag& reported)
+    {
+        if (!reported.test_and_set()) {
+            std::fprintf(stderr, "uscope: could not %s: %s\n", what, std::strerror(errno));
+        }
+    }
+
+    void apply_affinity(const Placement& placement, int thread_index, int thread_count)
+    {
+        if (sched_getaffinity(0, sizeof(previous_affinity_), &previous_affinity_) != 0) {
+            static std::atomic_flag reported;
+            warn("read the CPU affinity", reported);
+            return;
+        }
+        cpu_set_t affinity;
+        CPU_ZERO(&affinity);
+        if (thread_count > 1) {
+            const auto index = static_cast<size_t>(thread_index) % placement.cpus.size();
+            CPU_SET(placement.cpus[index], &affinity);
+        } else {
+            for (const int cpu : placement.cpus) {
+                CPU_SET(cpu, &affinity);
+            }
+        }
+        if (sched_setaffinity(0, sizeof(affinity), &affinity) != 0) {
+            static std::atomic_flag reported;
+            warn("set the CPU affinity", reported);
+            return;
+        }
+        restore_affinity_ = true;
+    }
+
+    void apply_memory_policy(const Placement& placement)
+    {
+        if (syscall(
+                SYS_get_mempolicy,
+                &previous_memory_policy_,
+                previous_nodes_.data(),
+                kMaxNodes + 1,
+                nullptr,
+                0)
+            != 0) {
+            static std::atomic_flag reported;
+            warn("read the NUMA memory policy", reported);
+            return;
+        }
+        NodeMask nodes {};
+        for (const int node : placement.numa_nodes) {
+            if (node >= 0 && static_cast<unsigned long>(node) < kMaxNodes) {
+                nodes[static_cast<size_t>(node) / kBitsPerWord] |= 1UL << (node % kBitsPerWord);
+            }
+        }
+        int mode = MPOL_DEFAULT;
+        switch (placement.numa_policy) {
+        case NumaPolicy::Default:
+            mode = MPOL_DEFAULT;
+            break;
+        case NumaPolicy::Local:
+            mode = MPOL_LOCAL;
+            break;
+        case NumaPolicy::Preferred:
+            mode = MPOL_PREFERRED;
+            break;
+        case NumaPolicy::Bind:
+            mode = MPOL_BIND;
+            break;
+        case NumaPolicy::Interleave:
+            mode = MPOL_INTERLEAVE;
+            break;
+        }
+        const bool takes_nodes = mode != MPOL_DEFAULT && mode != MPOL_LOCAL;
+        if (syscall(
+                SYS_set_mempolicy,
+                mode,
+                takes_nodes ? nodes.data() : nullptr,
+                takes_nodes ? kMaxNodes + 1 : 0)
+            != 0) {
+            static std::atomic_flag reported;
+            warn("set the NUMA memory policy", reported);
+            return;
+        }
+        restore_memory_policy_ = true;
+    }
+
+    void apply_priority(int priority)
+    {
+        if (pthread_getschedparam(pthread_self(), &previous_policy_, &previous_param_) != 0) {
+            return;
+        }
+        sched_param param {};
+        param.sched_priority = std::clamp(
+            priority,
+            sched_get_priority_min(SCHED_FIFO),
+            sched_get_priority_max(SCHED_FIFO));
+        if (const int error = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+            error != 0) {
+            errno = error;
+            static std::atomic_flag reported;
+            warn("switch to SCHED_FIFO", reported);
+            return;
+        }
+        restore_priority_ = true;
+    }
+
+    cpu_set_t previous_affinity_ {};
+    bool restore_affinity_ { false };
+    int previous_memory_policy_ { MPOL_DEFAULT };
+    NodeMask previous_nodes_ {};
+    bool restore_memory_policy_ { false };
+    int previous_policy_ { SCHED_OTHER };
+    sched_param previous_param_ {};
+    bool restore_priority_ { false };
+};
+#else
+class ScopedPlacement {
+public:
+    ScopedPlacement(const Placement& /*placement*/, int /*thread_index*/, int /*thread_count*/)
+    {
+    }
+
+    static std::vector<int> effective_cpus()
+    {
+        return {};
+    }
 };
+#endif
 
-} // namespace uscope
+#if defined(__linux__)
+// Counter group of the calling thread. When the kernel lets user space read every counter of the
+// group with rdpmc, the group stays enabled and windows are delimited by reading the counters,
+// which costs about as much as reading the TSC. Otherwise each window enables and disables the
+// group with an ioctl and the totals are read once at the end.
+class PerfCounterGroup {
+public:
+    explicit PerfCounterGroup(const std::vector<PerfCounter>& counters)
+    {
+        for (const auto& counter : counters) {
+            perf_event_attr attr {};
+            attr.size = sizeof(attr);
+            attr.type = counter.type;
+            attr.config = counter.config;
+            attr.disabled = fds_.empty() ? 1 : 0;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED
+                | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            const int group_fd = fds_.empty() ? -1 : fds_.front();
+            const auto fd
+                = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0));
+            if (fd < 0) {
+                static std::atomic_flag reported;
+                if (!reported.test_and_set()) {
+                    std::fprintf(
+                        stderr,
+                        "uscope: could not open perf counter %s: %s\n",
+                        counter.name.c_str(),
+                        std::strerror(errno));
+                }
+                close_all();
+                return;
+            }
+            fds_.push_back(fd);
+        }
+        totals_.assign(fds_.size(), 0);
+        window_start_.assign(fds_.size(), 0);
+#if defined(USCOPE_ARCH_X86)
+        use_rdpmc_ = !fds_.empty();
+        for (const int fd : fds_) {
+            void* page = mmap(nullptr, page_size(), PROT_READ, MAP_SHARED, fd, 0);
+            if (page == MAP_FAILED) {
+                use_rdpmc_ = false;
+                break;
+            }
+            pages_.push_back(static_cast<const volatile perf_event_mmap_page*>(page));
+            use_rdpmc_ = use_rdpmc_ && (pages_.back()->cap_user_rdpmc != 0);
+        }
+        if (use_rdpmc_) {
+            ioctl(fds_.front(), PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        }
+#endif
+    }
+
+    PerfCounterGroup(const PerfCounterGroup&) = delete;
+    PerfCounterGroup& operator=(const PerfCounterGroup&) = delete;
+
+    ~PerfCounterGroup()
+    {
+        close_all();
+    }
+
+    [[nodiscard]] bool valid() const
+    {
+        return !fds_.empty();
+    }
+
+    USCOPE_ALWAYS_INLINE void start()
+    {
+        if (use_rdpmc_) {
+            for (size_t index = 0; index < pages_.size(); ++index) {
+                window_start_[index] = read_user(pages_[index]);
+            }
+        } else {
+            ioctl(fds_.front(), PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        }
+    }
+
+    USCOPE_ALWAYS_INLINE void stop()
+    {
+        if (use_rdpmc_) {
+            for (size_t index = 0; index < pages_.size(); ++index) {
+                totals_[index] += read_user(pages_[index]) - window_start_[index];
+            }
+        } else {
+            ioctl(fds_.front(), PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+        }
+    }
+
+    // Counts over every window, in the order of the counters given to the constructor and scaled
+    // up when the kernel had to multiplex the group.
+    [[nodiscard]] std::vector<uint64_t> totals() const
+    {
+        if (use_rdpmc_ || fds_.empty()) {
+            return totals_;
+        }
+        std::vector<uint64_t> buffer(3 + fds_.size());
+        const auto bytes = static_cast<ssize_t>(buffer.size() * sizeof(uint64_t));
+        if (read(fds_.front(), buffer.data(), static_cast<size_t>(bytes)) != bytes) {
+            return totals_;
+        }
+        const uint64_t time_enabled = buffer[1];
+        const uint64_t time_running = buffer[2];
+        const double scale = (time_running > 0)
+            ? static_cast<double>(time_enabled) / static_cast<double>(time_running)
+            : 0.0;
+        std::vector<uint64_t> totals(fds_.size());
+        for (size_t index = 0; index < fds_.size(); ++index) {
+            totals[index] = static_cast<uint64_t>(static_cast<double>(buffer[3 + index]) * scale);
+        }
+        return totals;
+    }
+
+private:
+    static size_t page_size()
+    {
+        return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    }
+
+#if defined(USCOPE_ARCH_X86)
+    // Self-monitoring read sequence documented in linux/perf_event.h.
+    static USCOPE_ALWAYS_INLINE uint64_t read_user(const volatile perf_event_mmap_page* page)
+    {
+        uint32_t sequence = 0;
+        uint64_t count = 0;
+        do {
+            sequence = page->lock;
+            std::atomic_signal_fence(std::memory_order_seq_cst);
+            const uint32_t index = page->index;
+            count = static_cast<uint64_t>(page->offset);
+            if (page->cap_user_rdpmc != 0 && index != 0) {
+                const int width = page->pmc_width;
+                auto value = static_cast<int64_t>(__rdpmc(static_cast<int>(index - 1)));
+                value = static_cast<int64_t>(static_cast<uint64_t>(value) << (64 - width));
+                value >>= (64 - width);
+                count += static_cast<uint64_t>(value);
+            }
+            std::atomic_signal_fence(std::memory_order_seq_cst);
+        } while (page->lock != sequence);
+        return count;
+    }
+#else
+    static uint64_t read_user(const volatile perf_event_mmap_page* /*page*/)
+    {
+        return 0;
+    }
+#endif
+
+    void close_all()
+    {
+        for (const auto* page : pages_) {
+            munmap(const_cast<perf_event_mmap_page*>(page), page_size());
+        }
+        pages_.clear();
+        for (const int fd : fds_) {
+            close(fd);
+        }
+        fds_.clear();
+        use_rdpmc_ = false;
+    }
+
+    std::vector<int> fds_;
+    std::vector<const volatile perf_event_mmap_page*> pages_;
+    std::vector<uint64_t> window_start_;
+    std::vector<uint64_t> totals_;
+    bool use_rdpmc_ { false };
+};
+#else
+class PerfCounterGroup {
+public:
+    explicit PerfCounterGroup(const std::vector<PerfCounter>& /*counters*/)
+    {
+    }
+
+    [[nodiscard]] bool valid() const
+    {
+        return false;
+    }
+
+    void start()
+    {
+    }
+
+    void stop()
+    {
+    }
+
+    [[nodiscard]] std::vector<uint64_t> totals() const
+    {
+        return {};
+    }
+};
+#endif
+
+// Call stacks from the leaf, each with the number of times it was sampled.
+using StackCounts = std::map<std::vector<uint64_t>, uint64_t>;
+
+#if defined(__linux__)
+// Samples the user-space call stack of the calling thread kFrequency times per second of its CPU
+// time, between start() and stop() only. The kernel unwinds stacks with frame pointers, so code
+// built without -fno-omit-frame-pointer gives truncated stacks.
+class SamplingProfiler {
+public:
+    static constexpr uint64_t kFrequency = 4999;
+    static constexpr size_t kDataPages = 64;
+
+    SamplingProfiler()
+    {
+        perf_event_attr attr {};
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_SOFTWARE;
+        attr.config = PERF_COUNT_SW_TASK_CLOCK;
+        attr.sample_freq = kFrequency;
+        attr.freq = 1;
+        attr.sample_type = PERF_SAMPLE_CALLCHAIN;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.exclude_callchain_kernel = 1;
+        fd_ = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+        if (fd_ >= 0) {
+            void* mapping = mmap(
+                nullptr,
+                mapping_size(),
+                PROT_READ | PROT_WRITE,
+                MAP_SHARED,
+                fd_,
+                0);
+            if (mapping == MAP_FAILED) {
+                close(fd_);
+                fd_ = -1;
+            } else {
+                page_ = static_cast<perf_event_mmap_page*>(mapping);
+            }
+        }
+        if (fd_ < 0) {
+            static std::atomic_flag reported;
+            if (!reported.test_and_set()) {
+                std::fprintf(
+                    stderr,
+                    "uscope: could not open the sampling profiler: %s\n",
+                    std::strerror(errno));
+            }
+        }
+    }
+
+    SamplingProfiler(const SamplingProfiler&) = delete;
+    SamplingProfiler& operator=(const SamplingProfiler&) = delete;
+
+    ~SamplingProfiler()
+    {
+        if (page_ != nullptr) {
+            munmap(page_, mapping_size());
+        }
+        if (fd_ >= 0) {
+            close(fd_);
+        }
+    }
+
+    [[nodiscard]] bool valid() const
+    {
+        return fd_ >= 0;
+    }
+
+    USCOPE_ALWAYS_INLINE void start()
+    {
+        ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+    }
+
+    // The ring is only drained once half full, to keep the windows short.
+    USCOPE_ALWAYS_INLINE void stop()
+    {
+        ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+        if (__atomic_load_n(&page_->data_head, __ATOMIC_ACQUIRE) - page_->data_tail
+            > data_size() / 2) {
+            drain();
+        }
+    }
+
+    [[nodiscard]] const StackCounts& stacks()
+    {
+        drain();
+        return stacks_;
+    }
+
+private:
+    static size_t page_size()
+    {
+        return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    }
+
+    static size_t data_size()
+    {
+        return kDataPages * page_size();
+    }
+
+    static size_t mapping_size()
+    {
+        return (kDataPages + 1) * page_size();
+    }
+
+    // Records may wrap around the end of the ring.
+    void copy_out(uint64_t offset, void* destination, size_t size) const
+    {
+        const auto* data = reinterpret_cast<const std::byte*>(page_) + page_size();
+        const size_t start = offset % data_size();
+        const size_t first = std::min(size, data_size() - start);
+        std::memcpy(destination, data + start, first);
+        std::memcpy(static_cast<std::byte*>(destination) + first, data, size - first);
+    }
+
+    USCOPE_NOINLINE void drain()
+    {
+        const uint64_t head = __atomic_load_n(&page_->data_head, __ATOMIC_ACQUIRE);
+        uint64_t tail = page_->data_tail;
+        while (tail + sizeof(perf_event_header) <= head) {
+            perf_event_header header {};
+            copy_out(tail, &header, sizeof(header));
+            if (header.size < sizeof(header)) {
+                break;
+            }
+            if (header.type == PERF_RECORD_SAMPLE && header.size >= sizeof(header) + 8) {
+                record_.resize((header.size - sizeof(header)) / sizeof(uint64_t));
+                copy_out(tail + sizeof(header), record_.data(), record_.size() * sizeof(uint64_t));
+                const size_t count = std::min<size_t>(record_.front(), record_.size() - 1);
+                stack_.clear();
+                for (size_t index = 1; index <= count; ++index) {
+                    // Markers such as PERF_CONTEXT_USER sit among the addresses.
+                    if (record_[index] < static_cast<uint64_t>(PERF_CONTEXT_MAX)) {
+                        stack_.push_back(record_[index]);
+                    }
+                }
+                if (!stack_.empty()) {
+                    ++stacks_[stack_];
+                }
+            }
+            tail += header.size;
+        }
+        __atomic_store_n(&page_->data_tail, tail, __ATOMIC_RELEASE);
+    }
+
+    int fd_ { -1 };
+    perf_event_mmap_page* page_ { nullptr };
+    std::vector<uint64_t> record_;
+    std::vector<uint64_t> stack_;
+    StackCounts stacks_;
+};
+#else
+class SamplingProfiler {
+public:
+    [[nodiscard]] bool valid() const
+    {
+        return false;
+    }
+
+    void start()
+    {
+    }
+
+    void stop()
+    {
+    }
+
+    [[nodiscard]] const StackCounts& stacks()
+    {
+        return stacks_;
+    }
+
+private:
+    StackCounts stacks_;
+};
+#endif
+
+} // namespace detail
+
+// Welford's online mean and variance, along with the extrema.
+class RunningStatistics {
+public:
+    void add(double value)
+    {
+        ++count_;
+        const double delta = value - mean_;
+        mean_ += delta / static_cast<double>(count_);
+        m2_ += delta * (value - mean_);
+        min_ = std::min(min_, value);
+        max_ = std::max(max_, value);
+    }
+
+    [[nodiscard]] uint64_t count() const
+    {
+        return count_;
+    }
+
+    [[nodiscard]] double mean() const
+    {
+        return mean_;
+    }
+
+    [[nodiscard]] double variance() const
+    {
+        return (count_ > 1) ? m2_ / static_cast<double>(count_ - 1) : 0.0;
+    }
+
+    [[nodiscard]] double stddev() const
+    {
+        return std::sqrt(variance());
+    }
+
+    [[nodiscard]] double min() const
+    {
+        return (count_ > 0) ? min_ : 0.0;
+    }
+
+    [[nodiscard]] double max() const
+    {
+        return (count_ > 0) ? max_ : 0.0;
+    }
+
+    // Standard error of the mean relative to the mean, or infinity when there are not enough
+    // values to estimate it.
+    [[nodiscard]] double relative_standard_error() const
+    {
+        if (count_ < 2 || mean_ <= 0.0) {
+            return std::numeric_limits<double>::infinity();
+        }
+        return stddev() / std::sqrt(static_cast<double>(count_)) / mean_;
+    }
+
+    // Chan et al. pairwise combination, so statistics gathered on several threads can be merged.
+    void merge(const RunningStatistics& other)
+    {
+        if (other.count_ == 0) {
+            return;
+        }
+        const uint64_t count = count_ + other.count_;
+        const double delta = other.mean_ - mean_;
+        const double weight = static_cast<double>(other.count_) / static_cast<double>(count);
+        mean_ += delta * weight;
+        m2_ += other.m2_ + (delta * delta * static_cast<double>(count_) * weight);
+        count_ = count;
+        min_ = std::min(min_, other.min_);
+        max_ = std::max(max_, other.max_);
+    }
+
+private:
+    uint64_t count_ { 0 };
+    double mean_ { 0.0 };
+    double m2_ { 0.0 };
+    double min_ { std::numeric_limits<double>::infinity() };
+    double max_ { -std::numeric_limits<double>::infinity() };
+};
+
+// Log-linear histogram in the style of HdrHistogram, recording values in picoseconds. Each power
+// of two range is split into kSubBucketCount linear buckets, which bounds the relative error of a
+// reported quantile to 1 / (2 * kSubBucketCount) over the whole 64-bit range in constant memory.
+struct HistogramBucket {
+    uint64_t index;
+    uint64_t count;
+};
+
+class Histogram {
+public:
+    static constexpr int kSubBucketBits = 6;
+    static constexpr uint64_t kSubBucketCount = uint64_t { 1 } << kSubBucketBits;
+    static constexpr size_t kBucketCount = (65 - kSubBucketBits) * kSubBucketCount;
+    static constexpr double kUnitsPerNs = 1000.0;
+
+    void record(double value_ns)
+    {
+        const double units = std::max(value_ns * kUnitsPerNs, 0.0);
+        const uint64_t value = (units >= 0x1p64) ? std::numeric_limits<uint64_t>::max()
+                                                 : static_cast<uint64_t>(units + 0.5);
+        ++counts_[bucket_index(value)];
+        ++total_count_;
+    }
+
+    [[nodiscard]] uint64_t total_count() const
+    {
+        return total_count_;
+    }
+
+    // Midpoint of the bucket holding the sample of rank ceil(quantile * total_count()).
+    [[nodiscard]] double value_at_quantile(double quantile) const
+    {
+        if (total_count_ == 0) {
+            return 0.0;
+        }
+        const auto rank = std::clamp<uint64_t>(
+            static_cast<uint64_t>(std::ceil(quantile * static_cast<double>(total_count_))),
+            1,
+            total_count_);
+        uint64_t cumulative = 0;
+        for (size_t index = 0; index < kBucketCount; ++index) {
+            cumulative += counts_[index];
+            if (cumulative >= rank) {
+                return bucket_midpoint_ns(index);
+            }
+        }
+        return 0.0;
+    }
+
+    [[nodiscard]] uint64_t count_at(size_t index) const
+    {
+        return counts_[index];
+    }
+
+    // The non-empty buckets, which is what gets serialized.
+    [[nodiscard]] std::vector<HistogramBucket> buckets() const
+    {
+        std::vector<HistogramBucket> buckets;
+        for (size_t index = 0; index < kBucketCount; ++index) {
+            if (counts_[index] != 0) {
+                buckets.push_back({ index, counts_[index] });
+            }
+        }
+        return buckets;
+    }
+
+    // Samples in the buckets whose midpoint is below, or above, value_ns.
+    [[nodiscard]] uint64_t count_below(double value_ns) const
+    {
+        uint64_t count = 0;
+        for (size_t index = 0; index < kBucketCount && bucket_midpoint_ns(index) < value_ns;
+             ++index) {
+            count += counts_[index];
+        }
+        return count;
+    }
+
+    [[nodiscard]] uint64_t count_above(double value_ns) const
+    {
+        uint64_t count = 0;
+        for (size_t index = kBucketCount; index-- > 0 && bucket_midpoint_ns(index) > value_ns;) {
+            count += counts_[index];
+        }
+        return count;
+    }
+
+    // Rebuilds a histogram from its buckets.
+    void add_count(size_t index, uint64_t count)
+    {
+        counts_[index] += count;
+        total_count_ += count;
+    }
+
+    void merge(const Histogram& other)
+    {
+        for (size_t index = 0; index < kBucketCount; ++index) {
+            counts_[index] += other.counts_[index];
+        }
+        total_count_ += other.total_count_;
+    }
+
+    static constexpr size_t bucket_index(uint64_t value)
+    {
+        if (value < kSubBucketCount) {
+            return static_cast<size_t>(value);
+        }
+        const auto shift = static_cast<int>(std::bit_width(value)) - 1 - kSubBucketBits;
+        return (static_cast<size_t>(shift) * kSubBucketCount) + static_cast<size_t>(value >> shift);
+    }
+
+    static constexpr uint64_t bucket_lower_bound(size_t index)
+    {
+        if (index < 2 * kSubBucketCount) {
+            return index;
+        }
+        const auto shift = static_cast<int>(index / kSubBucketCount) - 1;
+        return (index - (static_cast<size_t>(shift) * kSubBucketCount)) << shift;
+    }
+
+    static constexpr uint64_t bucket_width(size_t index)
+    {
+        if (index < 2 * kSubBucketCount) {
+            return 1;
+        }
+        return uint64_t { 1 } << ((index / kSubBucketCount) - 1);
+    }
+
+    static constexpr double bucket_midpoint_ns(size_t index)
+    {
+        const auto lower = static_cast<double>(bucket_lower_bound(index));
+        const auto width = static_cast<double>(bucket_width(index));
+        return (lower + ((width - 1.0) / 2.0)) / kUnitsPerNs;
+    }
+
+private:
+    std::array<uint64_t, kBucketCount> counts_ {};
+    uint64_t total_count_ { 0 };
+};
+
+// Samples outside the mild fences of OutlierMethod, the severe ones counted apart.
+struct Outliers {
+    uint64_t samples { 0 };
+    uint64_t low_severe { 0 };
+    uint64_t low_mild { 0 };
+    uint64_t high_mild { 0 };
+    uint64_t high_severe { 0 };
+
+    [[nodiscard]] uint64_t total() const
+    {
+        return low_severe + low_mild + high_mild + high_severe;
+    }
+};
+
+inline Outliers classify_outliers(const Histogram& histogram, OutlierMethod method)
+{
+    Outliers outliers { .samples = histogram.total_count() };
+    if (outliers.samples == 0) {
+        return outliers;
+    }
+    double mild_low = 0.0;
+    double mild_high = 0.0;
+    double severe_low = 0.0;
+    double severe_high = 0.0;
+    if (method == OutlierMethod::Iqr) {
+        const double q1 = histogram.value_at_quantile(0.25);
+        const double q3 = histogram.value_at_quantile(0.75);
+        const double iqr = q3 - q1;
+        mild_low = q1 - (1.5 * iqr);
+        mild_high = q3 + (1.5 * iqr);
+        severe_low = q1 - (3.0 * iqr);
+        severe_high = q3 + (3.0 * iqr);
+    } else {
+        // The weighted median of the distances of the bucket midpoints to the median.
+        const double median = histogram.value_at_quantile(0.5);
+        std::vector<std::pair<double, uint64_t>> deviations;
+        for (size_t index = 0; index < Histogram::kBucketCount; ++index) {
+            if (histogram.count_at(index) != 0) {
+                deviations.emplace_back(
+                    std::abs(Histogram::bucket_midpoint_ns(index) - median),
+                    histogram.count_at(index));
+            }
+        }
+        std::ranges::sort(deviations);
+        uint64_t cumulative = 0;
+        double mad = 0.0;
+        for (const auto& [deviation, count] : deviations) {
+            cumulative += count;
+            if (2 * cumulative >= outliers.samples) {
+                mad = deviation;
+                break;
+            }
+        }
+        // Scaled to estimate the standard deviation of normally distributed samples.
+        const double sigma = 1.4826 * mad;
+        mild_low = median - (3.0 * sigma);
+        mild_high = median + (3.0 * sigma);
+        severe_low = median - (5.0 * sigma);
+        severe_high = median + (5.0 * sigma);
+    }
+    outliers.low_severe = histogram.count_below(severe_low);
+    outliers.low_mild = histogram.count_below(mild_low) - outliers.low_severe;
+    outliers.high_severe = histogram.count_above(severe_high);
+    outliers.high_mild = histogram.count_above(mild_high) - outliers.high_severe;
+    return outliers;
+}
+
+namespace detail {
+
+// First line of path, or the value after the colon of its first line starting with key.
+inline std::string read_text_line(const char* path, std::string_view key = {})
+{
+    std::FILE* file = std::fopen(path, "r");
+    if (file == nullptr) {
+        return {};
+    }
+    std::string value;
+    std::array<char, 512> line {};
+    while (std::fgets(line.data(), static_cast<int>(line.size()), file) != nullptr) {
+        std::string_view text(line.data());
+        while (!text.empty() && (text.back() == '\n' || text.back() == ' ')) {
+            text.remove_suffix(1);
+        }
+        if (!key.empty()) {
+            const size_t colon = text.find(':');
+            if (!text.starts_with(key) || colon == std::string_view::npos) {
+                continue;
+            }
+            text.remove_prefix(std::min(text.find_first_not_of(' ', colon + 1), text.size()));
+        }
+        value = text;
+        break;
+    }
+    std::fclose(file);
+    return value;
+}
+
+inline constexpr size_t kCacheLineSize = 64;
+
+// Size of the largest cache of cpu0, or 32 MiB when it cannot be read.
+inline size_t last_level_cache_bytes()
+{
+    size_t largest = 0;
+#if defined(__linux__)
+    for (int index = 0;; ++index) {
+        const std::string directory
+            = "/sys/devices/system/cpu/cpu0/cache/index" + std::to_string(index) + "/";
+        const std::string size = read_text_line((directory + "size").c_str());
+        if (size.empty()) {
+            break;
+        }
+        size_t value = 0;
+        const auto [end, error] = std::from_chars(size.data(), size.data() + size.size(), value);
+        if (error != std::errc {}) {
+            continue;
+        }
+        const std::string_view unit(end, size.data() + size.size());
+        value *= unit.starts_with('M') ? 1024 * 1024 : unit.starts_with('K') ? 1024 : 1;
+        largest = std::max(largest, value);
+    }
+#endif
+    return (largest > 0) ? largest : size_t { 32 } << 20;
+}
+
+// Touches every line of a buffer twice the size of the last level cache, evicting whatever else
+// it held. Every thread allocates its own buffer on first use, so that threads of a run neither
+// race on the same bytes nor evict through each other's coherence traffic.
+inline void evict_last_level_cache()
+{
+    static const size_t size = 2 * last_level_cache_bytes();
+    thread_local const std::unique_ptr<uint8_t[]> buffer = std::make_unique<uint8_t[]>(size);
+    volatile uint8_t* lines = buffer.get();
+    for (size_t offset = 0; offset < size; offset += kCacheLineSize) {
+        lines[offset] = static_cast<uint8_t>(lines[offset] + 1);
+    }
+}
+
+struct FlushRegion {
+    const void* data;
+    size_t size;
+};
+
+// Writes back and invalidates the lines of the regions from every cache level, where the
+// architecture has an instruction for it, else evicts the whole last level cache.
+inline void flush_regions(std::span<const FlushRegion> regions)
+{
+#if defined(USCOPE_ARCH_X86) || (defined(USCOPE_ARCH_AARCH64) && !defined(_MSC_VER))
+    for (const FlushRegion& region : regions) {
+        const auto* bytes = static_cast<const uint8_t*>(region.data);
+        for (size_t offset = 0; offset < region.size; offset += kCacheLineSize) {
+#if defined(USCOPE_ARCH_X86)
+            _mm_clflush(bytes + offset);
+#else
+            asm volatile("dc civac, %0" : : "r"(bytes + offset) : "memory");
+#endif
+        }
+    }
+#if defined(USCOPE_ARCH_X86)
+    _mm_mfence();
+#else
+    asm volatile("dsb ish" : : : "memory");
+#endif
+#else
+    static_cast<void>(regions);
+    evict_last_level_cache();
+#endif
+}
+
+// Heap allocations of the calling thread, counted by the operator new replacements that
+// USCOPE_TRACK_ALLOCATIONS defines. Plain thread-local increments, so the hooks never contend.
+struct AllocationCounters {
+    uint64_t allocations { 0 };
+    uint64_t bytes { 0 };
+};
+
+inline thread_local AllocationCounters thread_allocations {};
+
+// Set during static initialization by the translation unit defining the hooks.
+inline bool allocation_tracking = false;
+
+} // namespace detail
+
+// Immutable data shared by the runs of a runner, built on first use and kept while consecutive
+// runs ask for it. An entry nobody holds any more is dropped when another one has to be built, so
+// a family iterating over a 2 GB dataset builds it once, and only one such dataset stays alive
+// when the next family needs another.
+class DataCache {
+public:
+    // Data keyed by tag, usually the fixture type, and arguments. Build is called with the
+    // arguments on a miss, with the cache locked, so that the threads of a run build it once.
+    template<typename Tag, typename Build>
+    auto get(std::span<const Argument> arguments, Build&& build)
+        -> std::shared_ptr<const std::invoke_result_t<Build&, std::span<const Argument>>>
+    {
+        using Data = std::invoke_result_t<Build&, std::span<const Argument>>;
+        const std::type_index tag = typeid(Tag);
+        const std::scoped_lock lock(mutex_);
+        const auto it = std::ranges::find_if(entries_, [&](const Entry& entry) {
+            return entry.tag == tag && std::ranges::equal(entry.arguments, arguments);
+        });
+        if (it != entries_.end()) {
+            return std::static_pointer_cast<const Data>(it->data);
+        }
+        std::erase_if(entries_, [](const Entry& entry) { return entry.data.use_count() == 1; });
+        auto data = std::make_shared<const Data>(std::invoke(build, arguments));
+        entries_.push_back(Entry {
+            .tag = tag,
+            .arguments = std::vector<Argument>(arguments.begin(), arguments.end()),
+            .data = data,
+        });
+        return data;
+    }
+
+    void clear()
+    {
+        const std::scoped_lock lock(mutex_);
+        entries_.clear();
+    }
+
+private:
+    struct Entry {
+        std::type_index tag;
+        std::vector<Argument> arguments;
+        std::shared_ptr<const void> data;
+    };
+
+    std::mutex mutex_;
+    std::vector<Entry> entries_;
+};
+
+// Iterations are handed out in batches of batch_size and only the batch edges are timestamped,
+// so the per-iteration fast path of keep_running() is a decrement and a compare. A batch_size of 1
+// times every iteration individually.
+class BenchmarkState {
+public:
+    explicit BenchmarkState(Iteration iteration_count, const Config& config = {})
+        : BenchmarkState(iteration_count, config, 0, 1, nullptr)
+    {
+    }
+
+    // Every thread of a multi-threaded run waits on start_barrier before its first batch.
+    BenchmarkState(
+        Iteration iteration_count,
+        const Config& config,
+        int thread_index,
+        int thread_count,
+        std::barrier<>* start_barrier,
+        std::span<const Argument> arguments = {},
+        DataCache* data_cache = nullptr)
+        : total_iterations_(iteration_count)
+        , remaining_iterations_(iteration_count)
+        , batch_size_(
+              (config.open_loop_rate > 0.0) ? 1 : std::max<Iteration>(config.batch_size, 1))
+        , clock_(CycleCounterClock::available ? config.clock : ClockSource::Steady)
+        , ns_per_tick_(clock_info(clock_).ns_per_tick)
+        , keep_samples_(config.sample_storage == SampleStorage::Raw)
+        , cache_mode_(config.cache_mode)
+        , warmup_iterations_((cache_mode_ == CacheMode::Warm) ? config.warmup_iterations : 0)
+        , arrival_gap_ticks_(
+              (config.open_loop_rate > 0.0)
+                  ? 1e9 * thread_count / config.open_loop_rate / ns_per_tick_
+                  : 0.0)
+        , poisson_arrivals_(config.arrivals == Arrivals::Poisson)
+        , arrival_generator_(static_cast<uint64_t>(thread_index) + 1)
+        , perf_counter_specs_(config.perf_counters)
+        , profiled_(!config.profile.empty())
+        , thread_index_(thread_index)
+        , thread_count_(thread_count)
+        , start_barrier_(start_barrier)
+        , arguments_(arguments.begin(), arguments.end())
+        , data_cache_(data_cache)
+    {
+        if (keep_samples_) {
+            iterations_time_.reserve((total_iterations_ + batch_size_ - 1) / batch_size_);
+        }
+    }
+
+    [[nodiscard]] bool keep_running()
+    {
+        if (batch_remaining_-- > 0) [[likely]] {
+            return true;
+        }
+        return next_batch();
+    }
+
+    // for (auto _ : state) runs the same iterations as while (state.keep_running()), but the count
+    // of the current batch lives in the iterator, which the compiler keeps in a register: the loop
+    // compiles to a decrement and a branch around the body, the clock only read between batches.
+    // remaining_iterations() then only counts the batches left. Through StaticState the batches
+    // start with the clock and batch size of its StaticConfig as constants.
+    struct [[maybe_unused]] Value { };
+    struct Sentinel { };
+
+    template<detail::BatchTiming Timing>
+    class BasicIterator {
+    public:
+        explicit BasicIterator(BenchmarkState* state)
+            : state_(state)
+        {
+        }
+
+        Value operator*() const
+        {
+            return {};
+        }
+
+        BasicIterator& operator++()
+        {
+            --remaining_;
+            return *this;
+        }
+
+        bool operator!=(Sentinel)
+        {
+            if (remaining_ != 0) [[likely]] {
+                return true;
+            }
+            remaining_ = state_->template next_range<Timing>();
+            return remaining_ != 0;
+        }
+
+    private:
+        BenchmarkState* state_;
+        Iteration remaining_ { 0 };
+    };
+    using Iterator = BasicIterator<detail::BatchTiming {}>;
+
+    [[nodiscard]] Iterator begin()
+    {
+        return Iterator(this);
+    }
+
+    [[nodiscard]] Sentinel end() const
+    {
+        return {};
+    }
+
+    // Stops the clock and the perf counters until resume_timing(), to keep per-iteration setup out
+    // of the measurement. Batches are still timed as a whole, with the paused ticks subtracted, so
+    // the residual cost of a pause/resume pair is the only thing left in the samples.
+    void pause_timing()
+    {
+        if (state_ != State::Started || paused_) {
+            return;
+        }
+        pause_begin_ = read_stop();
+        if (perf_counters_) {
+            perf_counters_->stop();
+        }
+        if (profiler_) {
+            profiler_->stop();
+        }
+        count_allocations();
+        paused_ = true;
+    }
+
+    void resume_timing()
+    {
+        if (!paused_) {
+            return;
+        }
+        allocation_mark_ = detail::thread_allocations;
+        if (profiler_) {
+            profiler_->start();
+        }
+        if (perf_counters_) {
+            perf_counters_->start();
+        }
+        paused_ticks_ += read_start() - pause_begin_;
+        ++pause_count_;
+        paused_ = false;
+    }
+
+    [[nodiscard]] Iteration pause_count() const
+    {
+        return pause_count_;
+    }
+
+    // Heap allocations in the timed region, pauses excluded. Always zero unless one translation
+    // unit defines USCOPE_TRACK_ALLOCATIONS.
+    [[nodiscard]] uint64_t allocation_count() const
+    {
+        return allocations_.allocations;
+    }
+
+    [[nodiscard]] uint64_t allocated_bytes() const
+    {
+        return allocations_.bytes;
+    }
+
+    // Lines flushed instead of the whole last level cache in CacheMode::Cold, typically the input
+    // of the benchmark registered by its fixture. The region has to stay valid for the run.
+    void add_flush_region(const void* data, size_t size)
+    {
+        flush_regions_.push_back(detail::FlushRegion { data, size });
+    }
+
+    // Evicts the caches as CacheMode::Cold does before every batch, within a batch, with the timing
+    // paused around it.
+    void flush_cache()
+    {
+        const bool timing = state_ == State::Started && !paused_;
+        if (timing) {
+            pause_timing();
+        }
+        evict_caches();
+        if (timing) {
+            resume_timing();
+        }
+    }
+
+    // Reported as bytes_per_second and items_per_second, typically set after the loop from
+    // completed_iterations().
+    void set_bytes_processed(int64_t bytes)
+    {
+        set_counter(
+            "bytes_per_second",
+            static_cast<double>(bytes),
+            Counter::Rate,
+            Counter::OneK::Is1024);
+    }
+
+    void set_items_processed(int64_t items)
+    {
+        set_counter("items_per_second", static_cast<double>(items), Counter::Rate);
+    }
+
+    // Sets or replaces the named counter.
+    void set_counter(
+        std::string_view name,
+        double value,
+        Counter::Flags flags = Counter::Default,
+        Counter::OneK one_k = Counter::OneK::Is1000)
+    {
+        const auto it = std::ranges::find(counters_, name, &std::pair<std::string, Counter>::first);
+        const Counter counter { .value = value, .flags = flags, .one_k = one_k };
+        if (it != counters_.end()) {
+            it->second = counter;
+        } else {
+            counters_.emplace_back(name, counter);
+        }
+    }
+
+    [[nodiscard]] const std::vector<std::pair<std::string, Counter>>& counters() const
+    {
+        return counters_;
+    }
+
+    // Data built from the arguments by build, shared with the other threads and with the following
+    // runs of the runner as long as they ask for the same tag and arguments. Meant for fixture
+    // setup, building is never timed there.
+    template<typename Tag, typename Build>
+    auto shared_data(Build&& build)
+        -> std::shared_ptr<const std::invoke_result_t<Build&, std::span<const Argument>>>
+    {
+        using Data = std::invoke_result_t<Build&, std::span<const Argument>>;
+        if (data_cache_ == nullptr) {
+            return std::make_shared<const Data>(std::invoke(build, arguments()));
+        }
+        return data_cache_->get<Tag>(arguments(), std::forward<Build>(build));
+    }
+
+    // The N of complexity fitting, when it is not the first argument.
+    void set_complexity_n(Argument n)
+    {
+        complexity_n_ = n;
+    }
+
+    [[nodiscard]] std::optional<Argument> complexity_n() const
+    {
+        return complexity_n_;
+    }
+
+    [[nodiscard]] Iteration remaining_iterations() const
+    {
+        return remaining_iterations_ + std::max<Iteration>(batch_remaining_, 0);
+    }
+
+    [[nodiscard]] Iteration batch_size() const
+    {
+        return batch_size_;
+    }
+
+    // Empty unless the state was created with SampleStorage::Raw.
+    [[nodiscard]] const std::vector<Sample>& samples() const
+    {
+        return iterations_time_;
+    }
+
+    void finish_thread()
+    {
+        leave_start_barrier(true);
+    }
+
+    // Totals of Config::perf_counters over the timed windows, empty when they could not be opened.
+    [[nodiscard]] std::vector<uint64_t> perf_counter_totals() const
+    {
+        return perf_counters_ ? perf_counters_->totals() : std::vector<uint64_t> {};
+    }
+
+    // Sampled in the timed windows, empty unless Config::profile is set and the profiler opened.
+    [[nodiscard]] const detail::StackCounts& profile_stacks()
+    {
+        static const detail::StackCounts kNone;
+        return profiler_ ? profiler_->stacks() : kNone;
+    }
+
+    // Statistics and histogram of the per-iteration time of each sample.
+    [[nodiscard]] const RunningStatistics& statistics() const
+    {
+        return statistics_;
+    }
+
+    [[nodiscard]] const Histogram& histogram() const
+    {
+        return histogram_;
+    }
+
+    [[nodiscard]] Iteration completed_iterations() const
+    {
+        return completed_iterations_;
+    }
+
+    [[nodiscard]] double elapsed_ns() const
+    {
+        return elapsed_ns_;
+    }
+
+    [[nodiscard]] double ns_per_tick() const
+    {
+        return ns_per_tick_;
+    }
+
+    [[nodiscard]] double mean_iteration_ns() const
+    {
+        return (completed_iterations_ > 0)
+            ? elapsed_ns_ / static_cast<double>(completed_iterations_)
+            : 0.0;
+    }
+
+    // Of the mean per-iteration time, see RunningStatistics::relative_standard_error().
+    [[nodiscard]] double relative_standard_error() const
+    {
+        return statistics_.relative_standard_error();
+    }
+
+    // Arguments of the benchmark family point being run, 0 past the last one.
+    [[nodiscard]] Argument arg(size_t index) const
+    {
+        return (index < arguments_.size()) ? arguments_[index] : 0;
+    }
+
+    [[nodiscard]] std::span<const Argument> arguments() const
+    {
+        return arguments_;
+    }
+
+    // Index of the thread running this state among the thread_count() threads running the same
+    // benchmark concurrently, for fixtures to shard their data.
+    [[nodiscard]] int thread_index() const
+    {
+        return thread_index_;
+    }
+
+    [[nodiscard]] int thread_count() const
+    {
+        return thread_count_;
+    }
+
+    // Clock ticks at the start of the first batch and at the end of the last one.
+    [[nodiscard]] int64_t first_start_ticks() const
+    {
+        return first_begin_;
+    }
+
+    [[nodiscard]] int64_t last_stop_ticks() const
+    {
+        return end_;
+    }
+
+    // Clock ticks spent evicting caches between the first and the last batch.
+    [[nodiscard]] int64_t untimed_ticks() const
+    {
+        return untimed_ticks_;
+    }
+
+private:
+    enum class State : uint8_t {
+        NotStarted,
+        WarmingUp,
+        Started,
+        Finished,
+        Skipped,
+    };
+
+    // Starts the next batch for BasicIterator, which counts its iterations itself.
+    template<detail::BatchTiming Timing>
+    USCOPE_NOINLINE Iteration next_range()
+    {
+        if (!advance_batch<Timing>()) {
+            return 0;
+        }
+        const Iteration count = batch_remaining_ + 1;
+        batch_remaining_ = 0;
+        return count;
+    }
+
+    USCOPE_NOINLINE bool next_batch()
+    {
+        return advance_batch<detail::BatchTiming {}>();
+    }
+
+    template<detail::BatchTiming Timing>
+    USCOPE_ALWAYS_INLINE bool advance_batch()
+    {
+        switch (state_) {
+        case State::Finished:
+        case State::Skipped: {
+            batch_remaining_ = 0;
+            return false;
+        }
+        case State::NotStarted:
+            // Warm-up iterations run as one untimed batch leaving no sample.
+            if (warmup_iterations_ > 0) {
+                state_ = State::WarmingUp;
+                batch_remaining_ = warmup_iterations_ - 1;
+                return true;
+            }
+            [[fallthrough]];
+        case State::WarmingUp: {
+            state_ = State::Started;
+            // Counters count for the calling thread, so they are opened on the benchmark thread.
+            if (!perf_counter_specs_.empty()) {
+                perf_counters_ = std::make_unique<detail::PerfCounterGroup>(perf_counter_specs_);
+                if (!perf_counters_->valid()) {
+                    perf_counters_.reset();
+                }
+            }
+            if (profiled_) {
+                profiler_ = std::make_unique<detail::SamplingProfiler>();
+                if (!profiler_->valid()) {
+                    profiler_.reset();
+                }
+            }
+            leave_start_barrier(false);
+        } break;
+        case State::Started: {
+            // A batch ending paused ends where the pause began, the counters already stopped.
+            if (paused_) {
+                end_ = pause_begin_;
+                ++pause_count_;
+                paused_ = false;
+            } else {
+                end_ = read_stop<Timing>();
+                if (perf_counters_) {
+                    perf_counters_->stop();
+                }
+                if (profiler_) {
+                    profiler_->stop();
+                }
+                count_allocations();
+            }
+            const double elapsed
+                = static_cast<double>(end_ - begin_ - paused_ticks_) * ns_per_tick_;
+            paused_ticks_ = 0;
+            record_sample(Sample { elapsed, current_batch_ });
+            elapsed_ns_ += elapsed;
+            completed_iterations_ += current_batch_;
+        } break;
+        }
+
+        if (remaining_iterations_ <= 0) {
+            state_ = State::Finished;
+            batch_remaining_ = 0;
+            return false;
+        }
+        // Open-loop iterations are timed one at a time whatever the batch size.
+        const Iteration batch_size
+            = (Timing.constant && arrival_gap_ticks_ <= 0.0) ? Timing.batch_size : batch_size_;
+        current_batch_ = std::min(batch_size, remaining_iterations_);
+        remaining_iterations_ -= current_batch_;
+        // The current call already accounts for the first iteration of the batch.
+        batch_remaining_ = current_batch_ - 1;
+        int64_t evict_ticks = 0;
+        if (cache_mode_ == CacheMode::Cold) {
+            const int64_t evict_begin = read_start<Timing>();
+            evict_caches();
+            evict_ticks = read_start<Timing>() - evict_begin;
+        }
+        // The open-loop wait comes before the counters and the profiler start, so that its spin is
+        // neither counted nor sampled.
+        const int64_t arrival
+            = (arrival_gap_ticks_ > 0.0) ? wait_for_arrival(read_start<Timing>()) : 0;
+        allocation_mark_ = detail::thread_allocations;
+        if (profiler_) {
+            profiler_->start();
+        }
+        if (perf_counters_) {
+            perf_counters_->start();
+        }
+        begin_ = (arrival_gap_ticks_ > 0.0) ? arrival : read_start<Timing>();
+        if (first_begin_ == 0) {
+            first_begin_ = begin_;
+        } else {
+            untimed_ticks_ += evict_ticks;
+        }
+        return true;
+    }
+
+    // Waits for the intended start of the next open-loop iteration and returns it. Behind
+    // schedule, the intended start is in the past and the time the iteration spent queued counts
+    // in its latency, which corrects the samples for coordinated omission.
+    int64_t wait_for_arrival(int64_t now)
+    {
+        if (next_arrival_ == 0.0) {
+            next_arrival_ = static_cast<double>(now);
+        }
+        const auto arrival = static_cast<int64_t>(next_arrival_);
+        next_arrival_ += poisson_arrivals_
+            ? std::exponential_distribution<double>(1.0 / arrival_gap_ticks_)(arrival_generator_)
+            : arrival_gap_ticks_;
+        while (now < arrival) {
+            now = read_start();
+        }
+        return arrival;
+    }
+
+    void count_allocations()
+    {
+        const detail::AllocationCounters& now = detail::thread_allocations;
+        allocations_.allocations += now.allocations - allocation_mark_.allocations;
+        allocations_.bytes += now.bytes - allocation_mark_.bytes;
+    }
+
+    void evict_caches() const
+    {
+        if (flush_regions_.empty()) {
+            detail::evict_last_level_cache();
+        } else {
+            detail::flush_regions(flush_regions_);
+        }
+    }
+
+    // A thread that never starts timing drops out of the barrier so the others are not blocked.
+    void leave_start_barrier(bool drop)
+    {
+        if (start_barrier_ == nullptr) {
+            return;
+        }
+        if (drop) {
+            start_barrier_->arrive_and_drop();
+        } else {
+            start_barrier_->arrive_and_wait();
+        }
+        start_barrier_ = nullptr;
+    }
+
+    void record_sample(const Sample& sample)
+    {
+        const double per_iteration = sample.per_iteration_ns();
+        statistics_.add(per_iteration);
+        histogram_.record(per_iteration);
+        if (keep_samples_) {
+            iterations_time_.push_back(sample);
+        }
+    }
+
+    template<detail::BatchTiming Timing = detail::BatchTiming {}>
+    USCOPE_ALWAYS_INLINE int64_t read_start() const noexcept
+    {
+        if constexpr (Timing.constant) {
+            return (Timing.clock == ClockSource::CycleCounter) ? CycleCounterClock::start()
+                                                               : SteadyClock::start();
+        }
+        return (clock_ == ClockSource::CycleCounter) ? CycleCounterClock::start()
+                                                     : SteadyClock::start();
+    }
+
+    template<detail::BatchTiming Timing = detail::BatchTiming {}>
+    USCOPE_ALWAYS_INLINE int64_t read_stop() const noexcept
+    {
+        if constexpr (Timing.constant) {
+            return (Timing.clock == ClockSource::CycleCounter) ? CycleCounterClock::stop()
+                                                               : SteadyClock::stop();
+        }
+        return (clock_ == ClockSource::CycleCounter) ? CycleCounterClock::stop()
+                                                     : SteadyClock::stop();
+    }
+
+    Iteration batch_remaining_ { 0 };
+    Iteration total_iterations_;
+    Iteration remaining_iterations_;
+    Iteration batch_size_;
+    Iteration current_batch_ { 0 };
+    Iteration completed_iterations_ { 0 };
+    double elapsed_ns_ { 0.0 };
+    ClockSource clock_;
+    double ns_per_tick_;
+    State state_ { State::NotStarted };
+    int64_t begin_ { 0 };
+    int64_t end_ { 0 };
+    int64_t first_begin_ { 0 };
+    int64_t pause_begin_ { 0 };
+    int64_t paused_ticks_ { 0 };
+    int64_t untimed_ticks_ { 0 };
+    Iteration pause_count_ { 0 };
+    detail::AllocationCounters allocation_mark_;
+    detail::AllocationCounters allocations_;
+    bool paused_ { false };
+    bool keep_samples_;
+    CacheMode cache_mode_;
+    Iteration warmup_iterations_;
+    double arrival_gap_ticks_;
+    double next_arrival_ { 0.0 };
+    bool poisson_arrivals_;
+    std::mt19937_64 arrival_generator_;
+    std::vector<detail::FlushRegion> flush_regions_;
+    std::vector<PerfCounter> perf_counter_specs_;
+    std::unique_ptr<detail::PerfCounterGroup> perf_counters_;
+    bool profiled_;
+    std::unique_ptr<detail::SamplingProfiler> profiler_;
+    int thread_index_;
+    int thread_count_;
+    std::barrier<>* start_barrier_;
+    std::vector<Argument> arguments_;
+    DataCache* data_cache_;
+    std::vector<std::pair<std::string, Counter>> counters_;
+    std::optional<Argument> complexity_n_;
+    RunningStatistics statistics_;
+    Histogram histogram_;
+    std::vector<Sample> iterations_time_;
+};
+
+// Pauses the timing of the enclosing state for its lifetime.
+class ScopedPause {
+public:
+    explicit ScopedPause(BenchmarkState& state)
+        : state_(state)
+    {
+        state_.pause_timing();
+    }
+
+    ~ScopedPause()
+    {
+        state_.resume_timing();
+    }
+
+    ScopedPause(const ScopedPause&) = delete;
+    ScopedPause& operator=(const ScopedPause&) = delete;
+
+private:
+    BenchmarkState& state_;
+};
+
+// What a function registered with USCOPE_BENCHMARK_STATIC or BenchmarkRunner::add_benchmark<>()
+// takes instead of a BenchmarkState: its for (auto _ : state) loop starts and times batches with
+// the clock and batch size of Options as constants. The runner gives the underlying state the same
+// settings, everything else of it is reached through state().
+template<StaticConfig Options>
+class StaticState {
+public:
+    static_assert(Options.iteration_count >= 0, "iteration_count must not be negative");
+    static_assert(Options.batch_size > 0, "batch_size must be positive");
+
+    using Iterator = BenchmarkState::BasicIterator<detail::batch_timing(Options)>;
+
+    explicit StaticState(BenchmarkState& state)
+        : state_(state)
+    {
+    }
+
+    [[nodiscard]] Iterator begin()
+    {
+        return Iterator(&state_);
+    }
+
+    [[nodiscard]] BenchmarkState::Sentinel end() const
+    {
+        return {};
+    }
+
+    [[nodiscard]] BenchmarkState& state() const
+    {
+        return state_;
+    }
+
+private:
+    BenchmarkState& state_;
+};
+
+template<typename Fn, typename... Args>
+concept BenchmarkFunction = std::invocable<Fn, BenchmarkState&>
+    && std::is_void_v<typename std::invoke_result_t<Fn, BenchmarkState&>>;
+
+// Takes a StaticState<Options>, or else a plain BenchmarkState run with the settings of Options.
+template<typename Fn, StaticConfig Options>
+concept StaticBenchmarkFunction = (std::invocable<Fn, StaticState<Options>&>
+                                      && std::is_void_v<
+                                          std::invoke_result_t<Fn, StaticState<Options>&>>)
+    || BenchmarkFunction<Fn>;
+
+// Per-thread state around the runs of a benchmark: every thread of a run default-constructs its
+// own fixture, calls setup() before and teardown() after the benchmark function, both untimed.
+// Expensive inputs belong in BenchmarkState::shared_data() rather than in the fixture.
+template<typename F>
+concept BenchmarkFixture = std::default_initializable<F>
+    && requires(F& fixture, BenchmarkState& state) {
+           fixture.setup(state);
+           fixture.teardown(state);
+       };
+
+// Base with empty setup and teardown, for fixtures needing only one of them.
+struct Fixture {
+    void setup(BenchmarkState&) { }
+    void teardown(BenchmarkState&) { }
+};
+
+template<typename T = void>
+class Task;
+
+namespace detail {
+
+struct TaskPromiseBase {
+    struct FinalAwaiter {
+        [[nodiscard]] bool await_ready() const noexcept
+        {
+            return false;
+        }
+
+        // Resumes the awaiter of a task that suspended on the way, see Task::operator co_await().
+        template<typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+        {
+            return handle.promise().continuation;
+        }
+
+        void await_resume() const noexcept { }
+    };
+
+    std::suspend_always initial_suspend() noexcept
+    {
+        return {};
+    }
+
+    FinalAwaiter final_suspend() noexcept
+    {
+        return {};
+    }
+
+    void unhandled_exception() noexcept
+    {
+        exception = std::current_exception();
+    }
+
+    void rethrow() const
+    {
+        if (exception) {
+            std::rethrow_exception(exception);
+        }
+    }
+
+    std::coroutine_handle<> continuation { std::noop_coroutine() };
+    std::exception_ptr exception;
+};
+
+template<typename T>
+struct TaskPromise : TaskPromiseBase {
+    Task<T> get_return_object() noexcept;
+
+    template<typename U>
+        requires std::convertible_to<U, T>
+    void return_value(U&& result)
+    {
+        value.emplace(std::forward<U>(result));
+    }
+
+    T take()
+    {
+        rethrow();
+        return std::move(*value);
+    }
+
+    std::optional<T> value;
+};
+
+template<>
+struct TaskPromise<void> : TaskPromiseBase {
+    Task<void> get_return_object() noexcept;
+
+    void return_void() noexcept { }
+
+    void take() const
+    {
+        rethrow();
+    }
+};
+
+} // namespace detail
+
+// Lazy coroutine returning a T, started when awaited and resuming its awaiter when done. Async
+// benchmarks return a Task<> and await whatever the measured code path awaits, frame allocations
+// and suspensions included.
+template<typename T>
+class [[nodiscard]] Task {
+public:
+    using promise_type = detail::TaskPromise<T>;
+
+    Task(Task&& other) noexcept
+        : handle_(std::exchange(other.handle_, {}))
+    {
+    }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+    Task& operator=(Task&&) = delete;
+
+    ~Task()
+    {
+        if (handle_) {
+            handle_.destroy();
+        }
+    }
+
+    auto operator co_await() const noexcept
+    {
+        struct Awaiter {
+            std::coroutine_handle<promise_type> handle;
+
+            [[nodiscard]] bool await_ready() const noexcept
+            {
+                return handle.done();
+            }
+
+            // A task completing without suspending returns here rather than resuming the
+            // awaiter, so a loop awaiting such tasks keeps a flat stack even where compilers do
+            // not turn symmetric transfer into a tail call, as GCC does not without optimization.
+            bool await_suspend(std::coroutine_handle<> awaiting)
+            {
+                handle.promise().continuation = std::noop_coroutine();
+                handle.resume();
+                if (handle.done()) {
+                    return false;
+                }
+                handle.promise().continuation = awaiting;
+                return true;
+            }
+
+            T await_resume()
+            {
+                return handle.promise().take();
+            }
+        };
+        return Awaiter { handle_ };
+    }
+
+private:
+    friend promise_type;
+    friend class Executor;
+
+    explicit Task(std::coroutine_handle<promise_type> handle) noexcept
+        : handle_(handle)
+    {
+    }
+
+    std::coroutine_handle<promise_type> handle_;
+};
+
+template<typename T>
+Task<T> detail::TaskPromise<T>::get_return_object() noexcept
+{
+    return Task<T>(std::coroutine_handle<TaskPromise>::from_promise(*this));
+}
+
+inline Task<void> detail::TaskPromise<void>::get_return_object() noexcept
+{
+    return Task<void>(std::coroutine_handle<TaskPromise>::from_promise(*this));
+}
+
+// Single-threaded executor of an async benchmark, on the thread running it. Awaitables resume a
+// suspended coroutine by posting it, and run() resumes the posted ones in order. When none is left
+// while the task is still suspended, run() calls the idle function, typically to wait for the
+// completions of the I/O submitted by awaitables, from an io_uring for instance, and post the
+// coroutines awaiting them.
+class Executor {
+public:
+    // Returns false when there is nothing left to wait for.
+    using IdleFunction = bool (*)(void* context);
+
+    Executor()
+        : ready_(kInitialCapacity)
+    {
+    }
+
+    Executor(const Executor&) = delete;
+    Executor& operator=(const Executor&) = delete;
+
+    // The executor of the async benchmark running on this thread.
+    [[nodiscard]] static Executor& current()
+    {
+        return *current_;
+    }
+
+    // The ring of ready coroutines only grows when more are posted than it holds, so posting
+    // allocates nothing in the timed region once warmed up.
+    void post(std::coroutine_handle<> handle)
+    {
+        if (count_ == ready_.size()) {
+            std::vector<std::coroutine_handle<>> grown(ready_.size() * 2);
+            for (size_t index = 0; index < count_; ++index) {
+                grown[index] = ready_[(head_ + index) % ready_.size()];
+            }
+            ready_ = std::move(grown);
+            head_ = 0;
+        }
+        ready_[(head_ + count_) % ready_.size()] = handle;
+        ++count_;
+    }
+
+    void on_idle(IdleFunction idle, void* context)
+    {
+        idle_ = idle;
+        idle_context_ = context;
+    }
+
+    // Posts the awaiting coroutine behind the ready ones: the bare cost of a suspension and a
+    // resumption.
+    [[nodiscard]] auto yield()
+    {
+        struct Awaiter {
+            Executor& executor;
+
+            [[nodiscard]] bool await_ready() const noexcept
+            {
+                return false;
+            }
+
+            void await_suspend(std::coroutine_handle<> handle)
+            {
+                executor.post(handle);
+            }
+
+            void await_resume() const noexcept { }
+        };
+        return Awaiter { *this };
+    }
+
+    // Until the task is done, rethrowing its exception if it has one. A task suspended with
+    // nothing to resume it is a bug of the benchmark and aborts.
+    void run(Task<> task)
+    {
+        Executor* const previous = std::exchange(current_, this);
+        post(task.handle_);
+        while (!task.handle_.done()) {
+            if (count_ == 0) {
+                if (idle_ == nullptr || !idle_(idle_context_)) {
+                    std::fprintf(stderr, "uscope: async benchmark suspended for good\n");
+                    std::abort();
+                }
+                continue;
+            }
+            const std::coroutine_handle<> handle = ready_[head_];
+            head_ = (head_ + 1) % ready_.size();
+            --count_;
+            handle.resume();
+        }
+        current_ = previous;
+        task.handle_.promise().take();
+    }
+
+private:
+    static constexpr size_t kInitialCapacity = 64;
+
+    inline static thread_local Executor* current_ { nullptr };
+
+    std::vector<std::coroutine_handle<>> ready_;
+    size_t head_ { 0 };
+    size_t count_ { 0 };
+    IdleFunction idle_ { nullptr };
+    void* idle_context_ { nullptr };
+};
+
+// Driven by an Executor of its own on each thread of the run, timed as usual by the keep_running()
+// loop inside the coroutine.
+template<typename Fn>
+concept AsyncBenchmarkFunction = std::invocable<Fn, BenchmarkState&>
+    && std::same_as<std::invoke_result_t<Fn, BenchmarkState&>, Task<>>;
+
+template<typename Signature, size_t Capacity = 4 * sizeof(void*)>
+class InplaceFunction;
+
+// Owning callable wrapper that never allocates: the callable is stored in an inline buffer of
+// Capacity bytes and has to fit in it. Plain function pointers, including those converted from
+// captureless lambdas, are stored with a constexpr constructor so that tables of benchmarks can be
+// constant-initialized.
+template<typename R, typename... Args, size_t Capacity>
+class InplaceFunction<R(Args...), Capacity> {
+public:
+    using FunctionPointer = R (*)(Args...);
+
+    constexpr InplaceFunction(FunctionPointer function) noexcept
+        : function_pointer_(function)
+        , invoke_(&invoke_function_pointer)
+    {
+    }
+
+    template<typename Fn>
+        requires(!std::is_convertible_v<Fn, FunctionPointer>)
+        && (!std::is_same_v<std::remove_cvref_t<Fn>, InplaceFunction>)
+        && std::is_invocable_r_v<R, std::decay_t<Fn>&, Args...>
+    InplaceFunction(Fn&& function)
+        : invoke_(&invoke_callable<std::decay_t<Fn>>)
+        , destroy_(&destroy_callable<std::decay_t<Fn>>)
+    {
+        using Callable = std::decay_t<Fn>;
+        static_assert(sizeof(Callable) <= Capacity, "callable does not fit in InplaceFunction");
+        static_assert(
+            alignof(Callable) <= alignof(std::max_align_t),
+            "callable is over-aligned for InplaceFunction");
+        ::new (static_cast<void*>(storage_)) Callable(std::forward<Fn>(function));
+    }
+
+    InplaceFunction(const InplaceFunction&) = delete;
+    InplaceFunction(InplaceFunction&&) = delete;
+    InplaceFunction& operator=(const InplaceFunction&) = delete;
+    InplaceFunction& operator=(InplaceFunction&&) = delete;
+
+    constexpr ~InplaceFunction()
+    {
+        if (destroy_ != nullptr) {
+            destroy_(*this);
+        }
+    }
+
+    R operator()(Args... args)
+    {
+        return invoke_(*this, std::forward<Args>(args)...);
+    }
+
+private:
+    static R invoke_function_pointer(InplaceFunction& self, Args&&... args)
+    {
+        return self.function_pointer_(std::forward<Args>(args)...);
+    }
+
+    template<typename Callable>
+    static R invoke_callable(InplaceFunction& self, Args&&... args)
+    {
+        return std::invoke(
+            *std::launder(reinterpret_cast<Callable*>(self.storage_)),
+            std::forward<Args>(args)...);
+    }
+
+    template<typename Callable>
+    static void destroy_callable(InplaceFunction& self)
+    {
+        std::launder(reinterpret_cast<Callable*>(self.storage_))->~Callable();
+    }
+
+    union {
+        FunctionPointer function_pointer_;
+        alignas(std::max_align_t) std::byte storage_[Capacity];
+    };
+    R (*invoke_)(InplaceFunction&, Args&&...);
+    void (*destroy_)(InplaceFunction&) { nullptr };
+};
+
+// One dimension of the arguments of a benchmark family. Values are computed on access, so a long
+// sweep costs nothing until it runs.
+class ArgumentAxis {
+public:
+    static ArgumentAxis values(std::vector<Argument> values)
+    {
+        ArgumentAxis axis;
+        axis.size_ = values.size();
+        axis.values_ = std::move(values);
+        return axis;
+    }
+
+    // first, every power of multiplier strictly between first and last, then last.
+    static ArgumentAxis range(Argument first, Argument last, Argument multiplier = 8)
+    {
+        ArgumentAxis axis;
+        axis.kind_ = Kind::Range;
+        axis.first_ = std::max<Argument>(first, 0);
+        axis.last_ = std::max(last, axis.first_);
+        axis.factor_ = std::max<Argument>(multiplier, 2);
+        axis.size_ = (axis.last_ > axis.first_) ? 2 : 1;
+        // Powers are multiplied only while the product cannot overflow.
+        constexpr Argument kMax = std::numeric_limits<Argument>::max();
+        const Argument limit = kMax / axis.factor_;
+        while (axis.power_ <= axis.first_ && axis.power_ <= limit) {
+            axis.power_ *= axis.factor_;
+        }
+        for (Argument power = axis.power_; power > axis.first_ && power < axis.last_;) {
+            ++axis.size_;
+            if (power > limit) {
+                break;
+            }
+            power *= axis.factor_;
+        }
+        return axis;
+    }
+
+    // first, first + step, ... up to and including last.
+    static ArgumentAxis dense_range(Argument first, Argument last, Argument step = 1)
+    {
+        ArgumentAxis axis;
+        axis.kind_ = Kind::DenseRange;
+        axis.first_ = first;
+        axis.last_ = std::max(last, first);
+        axis.factor_ = std::max<Argument>(step, 1);
+        axis.size_ = static_cast<size_t>((axis.last_ - axis.first_) / axis.factor_) + 1;
+        return axis;
+    }
+
+    [[nodiscard]] size_t size() const
+    {
+        return size_;
+    }
+
+    [[nodiscard]] Argument operator[](size_t index) const
+    {
+        switch (kind_) {
+        case Kind::Values:
+            return values_[index];
+        case Kind::Range: {
+            if (index == 0 || index + 1 == size_) {
+                return (index == 0) ? first_ : last_;
+            }
+            Argument value = power_;
+            for (size_t step = 1; step < index; ++step) {
+                value *= factor_;
+            }
+            return value;
+        }
+        case Kind::DenseRange:
+            return first_ + (static_cast<Argument>(index) * factor_);
+        }
+        return 0;
+    }
+
+private:
+    enum class Kind : uint8_t {
+        Values,
+        Range,
+        DenseRange,
+    };
+
+    ArgumentAxis() = default;
+
+    Kind kind_ { Kind::Values };
+    Argument first_ { 0 };
+    Argument last_ { 0 };
+    // Multiplier of a range, step of a dense range.
+    Argument factor_ { 1 };
+    // First power of the multiplier above first_.
+    Argument power_ { 1 };
+    size_t size_ { 0 };
+    std::vector<Argument> values_;
+};
+
+// Growth of the time of a family with its complexity_n, fitted as the _BigO and _RMS results.
+enum class Complexity : uint8_t {
+    None,
+    O1,
+    OLogN,
+    ON,
+    ONLogN,
+    ONSquared,
+    ONCubed,
+    // Whichever of the above fits with the lowest RMS.
+    Auto,
+    // The ComplexityFunction given to Benchmark::complexity().
+    Lambda,
+};
+
+using ComplexityFunction = double (*)(Argument n);
+
+// Spelled as Google Benchmark does.
+inline std::string_view complexity_string(Complexity complexity)
+{
+    switch (complexity) {
+    case Complexity::O1:
+        return "(1)";
+    case Complexity::OLogN:
+        return "lgN";
+    case Complexity::ON:
+        return "N";
+    case Complexity::ONLogN:
+        return "NlgN";
+    case Complexity::ONSquared:
+        return "N^2";
+    case Complexity::ONCubed:
+        return "N^3";
+    default:
+        return "f(N)";
+    }
+}
+
+struct ComplexityPoint {
+    Argument n;
+    double time_ns;
+};
+
+struct ComplexityFit {
+    Complexity complexity;
+    // time_ns is approximated by coefficient * f(n).
+    double coefficient;
+    // Root mean square of the residuals, relative to the mean time.
+    double rms;
+};
+
+namespace detail {
+
+inline double complexity_term(Complexity complexity, Argument n)
+{
+    const double value = static_cast<double>(n);
+    switch (complexity) {
+    case Complexity::OLogN:
+        return std::log2(std::max(value, 1.0));
+    case Complexity::ON:
+        return value;
+    case Complexity::ONLogN:
+        return value * std::log2(std::max(value, 1.0));
+    case Complexity::ONSquared:
+        return value * value;
+    case Complexity::ONCubed:
+        return value * value * value;
+    default:
+        return 1.0;
+    }
+}
+
+} // namespace detail
+
+// Least squares fit of time_ns = coefficient * f(n) through the origin. Empty without at least two
+// distinct n, or for Complexity::Lambda without a function.
+inline std::optional<ComplexityFit> fit_complexity(
+    std::span<const ComplexityPoint> points,
+    Complexity complexity,
+    ComplexityFunction function = nullptr)
+{
+    if (complexity == Complexity::None || (complexity == Complexity::Lambda && function == nullptr)
+        || points.size() < 2) {
+        return std::nullopt;
+    }
+    const auto [lowest, highest] = std::ranges::minmax(points, {}, &ComplexityPoint::n);
+    if (lowest.n == highest.n) {
+        return std::nullopt;
+    }
+    if (complexity == Complexity::Auto) {
+        std::optional<ComplexityFit> best;
+        for (const Complexity candidate : {
+                 Complexity::O1,
+                 Complexity::OLogN,
+                 Complexity::ON,
+                 Complexity::ONLogN,
+                 Complexity::ONSquared,
+                 Complexity::ONCubed,
+             }) {
+            const std::optional<ComplexityFit> fit = fit_complexity(points, candidate);
+            if (fit && (!best || fit->rms < best->rms)) {
+                best = fit;
+            }
+        }
+        return best;
+    }
+    const auto term = [&](Argument n) {
+        return (complexity == Complexity::Lambda) ? function(n)
+                                                  : detail::complexity_term(complexity, n);
+    };
+    double term_time = 0.0;
+    double term_squared = 0.0;
+    double time = 0.0;
+    for (const ComplexityPoint& point : points) {
+        const double value = term(point.n);
+        term_time += value * point.time_ns;
+        term_squared += value * value;
+        time += point.time_ns;
+    }
+    if (term_squared == 0.0) {
+        return std::nullopt;
+    }
+    const double coefficient = term_time / term_squared;
+    double residuals = 0.0;
+    for (const ComplexityPoint& point : points) {
+        const double residual = point.time_ns - (coefficient * term(point.n));
+        residuals += residual * residual;
+    }
+    const auto count = static_cast<double>(points.size());
+    const double mean = time / count;
+    return ComplexityFit {
+        .complexity = complexity,
+        .coefficient = coefficient,
+        .rms = (mean > 0.0) ? std::sqrt(residuals / count) / mean : 0.0,
+    };
+}
+
+class BenchmarkList;
+
+// Benchmarks are intrusive list nodes, so registering one only links it and never allocates. The
+// name is a view and has to outlive every runner the benchmark is added to; string literals and
+// other static storage are the intended use.
+class Benchmark {
+public:
+    using Function = InplaceFunction<void(BenchmarkState&)>;
+
+    template<BenchmarkFunction Fn>
+    constexpr Benchmark(std::string_view name, Fn&& function)
+        : name_(name)
+        , function_(std::forward<Fn>(function))
+    {
+    }
+
+    // One instantiation of a templated kernel, named name<type_name>.
+    template<BenchmarkFunction Fn>
+    constexpr Benchmark(std::string_view name, std::string_view type_name, Fn&& function)
+        : name_(name)
+        , type_name_(type_name)
+        , function_(std::forward<Fn>(function))
+    {
+    }
+
+    Benchmark(const Benchmark&) = delete;
+    Benchmark(Benchmark&&) = delete;
+    Benchmark& operator=(const Benchmark&) = delete;
+    Benchmark& operator=(Benchmark&&) = delete;
+    constexpr ~Benchmark() = default;
+
+    void execute(BenchmarkState& state)
+    {
+        function_(state);
+    }
+
+    [[nodiscard]] std::string_view name() const
+    {
+        return name_;
+    }
+
+    [[nodiscard]] std::string_view type_name() const
+    {
+        return type_name_;
+    }
+
+    // Name including the type of a templated kernel, without arguments.
+    [[nodiscard]] std::string family_name() const
+    {
+        std::string family(name_);
+        if (!type_name_.empty()) {
+            family += '<';
+            family += type_name_;
+            family += '>';
+        }
+        return family;
+    }
+
+    // Each call adds an argument axis, the benchmark running once for every point of the Cartesian
+    // product of its axes, the last axis varying fastest.
+    Benchmark& args(std::initializer_list<Argument> values)
+    {
+        axes_.push_back(ArgumentAxis::values(values));
+        return *this;
+    }
+
+    Benchmark& range(Argument first, Argument last, Argument multiplier = 8)
+    {
+        axes_.push_back(ArgumentAxis::range(first, last, multiplier));
+        return *this;
+    }
+
+    Benchmark& dense_range(Argument first, Argument last, Argument step = 1)
+    {
+        axes_.push_back(ArgumentAxis::dense_range(first, last, step));
+        return *this;
+    }
+
+    // Names shown in front of the values of the axes, as in name/size:64.
+    Benchmark& arg_names(std::initializer_list<std::string_view> names)
+    {
+        argument_names_.assign(names);
+        return *this;
+    }
+
+    // Number of points of the family, 1 without axes.
+    [[nodiscard]] size_t argument_count() const
+    {
+        size_t count = 1;
+        for (const auto& axis : axes_) {
+            count *= axis.size();
+        }
+        return count;
+    }
+
+    [[nodiscard]] std::vector<Argument> arguments(size_t index) const
+    {
+        std::vector<Argument> values(axes_.size());
+        for (size_t axis = axes_.size(); axis-- > 0;) {
+            values[axis] = axes_[axis][index % axes_[axis].size()];
+            index /= axes_[axis].size();
+        }
+        return values;
+    }
+
+    // Family name followed by /value, or /name:value, for each argument but skipped_axis.
+    [[nodiscard]] std::string run_name(
+        std::span<const Argument> arguments,
+        std::optional<size_t> skipped_axis = std::nullopt) const
+    {
+        std::string name = family_name();
+        for (size_t index = 0; index < arguments.size(); ++index) {
+            if (index == skipped_axis) {
+                continue;
+            }
+            name += '/';
+            if (index < argument_names_.size()) {
+                name += argument_names_[index];
+                name += ':';
+            } else if (index == open_loop_axis_) {
+                name += "rate:";
+            }
+            name += std::to_string(arguments[index]);
+        }
+        return name;
+    }
+
+    // Runs the benchmark open loop, iterations starting at the given rates in iterations per
+    // second over all threads whether or not the previous ones finished, and timed from their
+    // intended start. The rates are one more argument axis, named rate unless arg_names() says
+    // otherwise.
+    Benchmark& open_loop(
+        std::initializer_list<Argument> rates,
+        Arrivals arrivals = Arrivals::Constant)
+    {
+        open_loop_axis_ = axes_.size();
+        arrivals_ = arrivals;
+        return args(rates);
+    }
+
+    // Open loop at first, first * multiplier, ... up to last, followed by a _knee result: the
+    // fastest rate sustained before latency takes off.
+    Benchmark& rate_sweep(
+        Argument first,
+        Argument last,
+        Argument multiplier = 2,
+        Arrivals arrivals = Arrivals::Constant)
+    {
+        open_loop_axis_ = axes_.size();
+        arrivals_ = arrivals;
+        return range(first, last, multiplier);
+    }
+
+    [[nodiscard]] std::optional<size_t> open_loop_axis() const
+    {
+        return open_loop_axis_;
+    }
+
+    [[nodiscard]] Arrivals arrivals() const
+    {
+        return arrivals_;
+    }
+
+    // Thread counts to run the benchmark with, overriding Config::threads when not empty.
+    Benchmark& threads(std::initializer_list<int> thread_counts)
+    {
+        threads_.assign(thread_counts);
+        return *this;
+    }
+
+    Benchmark& threads(std::vector<int> thread_counts)
+    {
+        threads_ = std::move(thread_counts);
+        return *this;
+    }
+
+    [[nodiscard]] const std::vector<int>& thread_counts() const
+    {
+        return threads_;
+    }
+
+    // Overrides Config::placement for this benchmark.
+    Benchmark& placement(Placement placement)
+    {
+        placement_ = std::move(placement);
+        return *this;
+    }
+
+    [[nodiscard]] const std::optional<Placement>& placement() const
+    {
+        return placement_;
+    }
+
+    // Fails the runs of the benchmark allocating in their timed region, which needs
+    // USCOPE_TRACK_ALLOCATIONS.
+    Benchmark& forbid_allocations(bool forbid = true)
+    {
+        forbid_allocations_ = forbid;
+        return *this;
+    }
+
+    [[nodiscard]] bool allocations_forbidden() const
+    {
+        return forbid_allocations_;
+    }
+
+    // Overrides Config::cache_mode for this benchmark.
+    Benchmark& cache_mode(CacheMode mode)
+    {
+        cache_mode_ = mode;
+        return *this;
+    }
+
+    [[nodiscard]] std::optional<CacheMode> cache_mode() const
+    {
+        return cache_mode_;
+    }
+
+    // Overrides the iteration count, when not 0, the batch size and the clock of Config for this
+    // benchmark. Set by USCOPE_BENCHMARK_STATIC to the settings its function is compiled for.
+    Benchmark& static_config(StaticConfig options)
+    {
+        static_config_ = options;
+        return *this;
+    }
+
+    [[nodiscard]] std::optional<StaticConfig> static_config() const
+    {
+        return static_config_;
+    }
+
+    // Fits the time of the family against the complexity_n of its runs, by default the first
+    // argument, once all of them ran.
+    Benchmark& complexity(Complexity complexity)
+    {
+        complexity_ = complexity;
+        return *this;
+    }
+
+    Benchmark& complexity(ComplexityFunction function)
+    {
+        complexity_ = Complexity::Lambda;
+        complexity_function_ = function;
+        return *this;
+    }
+
+    [[nodiscard]] Complexity complexity() const
+    {
+        return complexity_;
+    }
+
+    [[nodiscard]] ComplexityFunction complexity_function() const
+    {
+        return complexity_function_;
+    }
+
+private:
+    friend class BenchmarkList;
+
+    std::string_view name_;
+    std::string_view type_name_;
+    Function function_;
+    std::vector<ArgumentAxis> axes_;
+    std::vector<std::string_view> argument_names_;
+    std::vector<int> threads_;
+    std::optional<Placement> placement_;
+    std::optional<CacheMode> cache_mode_;
+    std::optional<StaticConfig> static_config_;
+    bool forbid_allocations_ { false };
+    std::optional<size_t> open_loop_axis_;
+    Arrivals arrivals_ { Arrivals::Constant };
+    Complexity complexity_ { Complexity::None };
+    ComplexityFunction complexity_function_ { nullptr };
+    Benchmark* next_ { nullptr };
+};
+
+// The instantiations of a templated kernel registered together, configured as one.
+class BenchmarkGroup {
+public:
+    explicit BenchmarkGroup(std::span<Benchmark> benchmarks)
+        : benchmarks_(benchmarks)
+    {
+    }
+
+    BenchmarkGroup& args(std::initializer_list<Argument> values)
+    {
+        return apply([&](Benchmark& benchmark) { benchmark.args(values); });
+    }
+
+    BenchmarkGroup& range(Argument first, Argument last, Argument multiplier = 8)
+    {
+        return apply([&](Benchmark& benchmark) { benchmark.range(first, last, multiplier); });
+    }
+
+    BenchmarkGroup& dense_range(Argument first, Argument last, Argument step = 1)
+    {
+        return apply([&](Benchmark& benchmark) { benchmark.dense_range(first, last, step); });
+    }
+
+    BenchmarkGroup& arg_names(std::initializer_list<std::string_view> names)
+    {
+        return apply([&](Benchmark& benchmark) { benchmark.arg_names(names); });
+    }
+
+    BenchmarkGroup& threads(std::initializer_list<int> thread_counts)
+    {
+        return apply([&](Benchmark& benchmark) { benchmark.threads(thread_counts); });
+    }
+
+    BenchmarkGroup& placement(const Placement& placement)
+    {
+        return apply([&](Benchmark& benchmark) { benchmark.placement(placement); });
+    }
+
+    BenchmarkGroup& open_loop(
+        std::initializer_list<Argument> rates,
+        Arrivals arrivals = Arrivals::Constant)
+    {
+        return apply([&](Benchmark& benchmark) { benchmark.open_loop(rates, arrivals); });
+    }
+
+    BenchmarkGroup& rate_sweep(
+        Argument first,
+        Argument last,
+        Argument multiplier = 2,
+        Arrivals arrivals = Arrivals::Constant)
+    {
+        return apply([&](Benchmark& benchmark) {
+            benchmark.rate_sweep(first, last, multiplier, arrivals);
+        });
+    }
+
+    BenchmarkGroup& forbid_allocations(bool forbid = true)
+    {
+        return apply([&](Benchmark& benchmark) { benchmark.forbid_allocations(forbid); });
+    }
+
+    BenchmarkGroup& cache_mode(CacheMode mode)
+    {
+        return apply([&](Benchmark& benchmark) { benchmark.cache_mode(mode); });
+    }
+
+    BenchmarkGroup& complexity(Complexity complexity)
+    {
+        return apply([&](Benchmark& benchmark) { benchmark.complexity(complexity); });
+    }
+
+    BenchmarkGroup& complexity(ComplexityFunction function)
+    {
+        return apply([&](Benchmark& benchmark) { benchmark.complexity(function); });
+    }
+
+    [[nodiscard]] std::span<Benchmark> benchmarks() const
+    {
+        return benchmarks_;
+    }
+
+private:
+    template<typename Fn>
+    BenchmarkGroup& apply(Fn&& function)
+    {
+        std::ranges::for_each(benchmarks_, function);
+        return *this;
+    }
+
+    std::span<Benchmark> benchmarks_;
+};
+
+// 1, 2, 4, ... up to and including max_threads, which defaults to the hardware concurrency.
+inline std::vector<int> doubling_thread_counts(
+    int max_threads = static_cast<int>(std::max(std::thread::hardware_concurrency(), 1U)))
+{
+    std::vector<int> thread_counts;
+    for (int thread_count = 1; thread_count < max_threads; thread_count *= 2) {
+        thread_counts.push_back(thread_count);
+    }
+    thread_counts.push_back(std::max(max_threads, 1));
+    return thread_counts;
+}
+
+class BenchmarkList {
+public:
+    class Iterator {
+    public:
+        using value_type = Benchmark;
+        using difference_type = std::ptrdiff_t;
+
+        Iterator() = default;
+
+        explicit Iterator(Benchmark* benchmark)
+            : benchmark_(benchmark)
+        {
+        }
+
+        Benchmark& operator*() const
+        {
+            return *benchmark_;
+        }
+
+        Benchmark* operator->() const
+        {
+            return benchmark_;
+        }
+
+        Iterator& operator++()
+        {
+            benchmark_ = benchmark_->next_;
+            return *this;
+        }
+
+        Iterator operator++(int)
+        {
+            Iterator previous = *this;
+            ++*this;
+            return previous;
+        }
+
+        bool operator==(const Iterator&) const = default;
+
+    private:
+        Benchmark* benchmark_ { nullptr };
+    };
+
+    void push_back(Benchmark& benchmark)
+    {
+        benchmark.next_ = nullptr;
+        if (tail_ == nullptr) {
+            head_ = &benchmark;
+        } else {
+            tail_->next_ = &benchmark;
+        }
+        tail_ = &benchmark;
+    }
+
+    [[nodiscard]] Iterator begin() const
+    {
+        return Iterator { head_ };
+    }
+
+    [[nodiscard]] Iterator end() const
+    {
+        return Iterator {};
+    }
+
+    [[nodiscard]] bool empty() const
+    {
+        return head_ == nullptr;
+    }
+
+private:
+    Benchmark* head_ { nullptr };
+    Benchmark* tail_ { nullptr };
+};
+
+// Per-iteration costs left in the timed windows by the timing itself.
+struct TimingOverhead {
+    double keep_running_ns { 0.0 };
+    // Of one pause_timing()/resume_timing() pair, on top of keep_running_ns.
+    double pause_resume_ns { 0.0 };
+};
+
+namespace detail {
+
+USCOPE_NOINLINE inline void empty_loop(BenchmarkState& state)
+{
+    while (state.keep_running()) {
+    }
+}
+
+USCOPE_NOINLINE inline void pause_resume_loop(BenchmarkState& state)
+{
+    while (state.keep_running()) {
+        const ScopedPause pause(state);
+    }
+}
+
+// Fastest mean per-iteration time of a few runs of loop, after a warm-up run.
+inline double min_mean_iteration_ns(
+    void (*loop)(BenchmarkState&),
+    Iteration iteration_count,
+    const Config& config)
+{
+    static constexpr int kRuns = 5;
+
+    Benchmark benchmark { "timing_overhead", loop };
+    double mean = std::numeric_limits<double>::infinity();
+    for (int run = 0; run <= kRuns; ++run) {
+        BenchmarkState state(
+            iteration_count,
+            Config {
+                .batch_size = config.batch_size,
+                .clock = config.clock,
+                .perf_counters = config.perf_counters,
+            });
+        benchmark.execute(state);
+        // The first run only warms up the caches and the branch predictors.
+        if (run > 0) {
+            mean = std::min(mean, state.mean_iteration_ns());
+        }
+    }
+    return mean;
+}
+
+// Per-iteration cost of an empty keep_running() loop and of a pause/resume pair, going through the
+// same Benchmark call path as real benchmarks. Measured once per process for each clock, batch size
+// and set of perf counters, keeping the fastest of a few runs so that preemptions do not inflate
+// the floor.
+inline TimingOverhead timing_overhead_ns(const Config& config)
+{
+    static constexpr Iteration kMinIterations = Iteration { 1 } << 16;
+    static constexpr Iteration kMaxIterations = Iteration { 1 } << 24;
+    static constexpr Iteration kSamplesPerRun = 256;
+    // Pauses read the clock twice per iteration whatever the batch size.
+    static constexpr Iteration kPauseIterations = Iteration { 1 } << 14;
+
+    Config timing_config = config;
+    timing_config.batch_size = std::max<Iteration>(config.batch_size, 1);
+    std::string counters;
+    for (const auto& counter : config.perf_counters) {
+        counters += counter.name;
+        counters += ',';
+    }
+    static std::map<std::tuple<ClockSource, Iteration, std::string>, TimingOverhead> cache;
+    const auto key = std::make_tuple(config.clock, timing_config.batch_size, counters);
+    if (const auto it = cache.find(key); it != cache.end()) {
+        return it->second;
+    }
+
+    TimingOverhead overhead;
+    overhead.keep_running_ns = min_mean_iteration_ns(
+        &empty_loop,
+        std::clamp(timing_config.batch_size * kSamplesPerRun, kMinIterations, kMaxIterations),
+        timing_config);
+    overhead.pause_resume_ns = std::max(
+        min_mean_iteration_ns(&pause_resume_loop, kPauseIterations, timing_config)
+            - overhead.keep_running_ns,
+        0.0);
+    return cache.emplace(key, overhead).first->second;
+}
+
+} // namespace detail
+
+// Per-iteration times in nanoseconds. Everything but raw_time_ns and stddev_ns has the overhead
+// subtracted when Config::subtract_overhead is set.
+namespace detail {
+
+// Samples of the threads that ran one benchmark concurrently, merged.
+struct Measurement {
+    int threads { 0 };
+    Iteration iterations { 0 };
+    double elapsed_ns { 0.0 };
+    double wall_ns { 0.0 };
+    RunningStatistics statistics;
+    Histogram histogram;
+    std::vector<Sample> samples;
+    std::vector<uint64_t> perf_counter_totals;
+    Iteration pauses { 0 };
+    uint64_t allocations { 0 };
+    uint64_t allocated_bytes { 0 };
+    // User counters summed over the threads, in the order they were first set.
+    std::vector<std::pair<std::string, Counter>> counters;
+    std::optional<Argument> complexity_n;
+
+    explicit Measurement(std::span<const BenchmarkState> states)
+        : threads(static_cast<int>(states.size()))
+    {
+        int64_t first_start = std::numeric_limits<int64_t>::max();
+        int64_t last_stop = std::numeric_limits<int64_t>::min();
+        int64_t untimed = 0;
+        double ns_per_tick = 1.0;
+        for (const auto& state : states) {
+            iterations += state.completed_iterations();
+            elapsed_ns += state.elapsed_ns();
+            pauses += state.pause_count();
+            allocations += state.allocation_count();
+            allocated_bytes += state.allocated_bytes();
+            if (!complexity_n) {
+                complexity_n = state.complexity_n();
+            }
+            for (const auto& [name, counter] : state.counters()) {
+                const auto it
+                    = std::ranges::find(counters, name, &std::pair<std::string, Counter>::first);
+                if (it != counters.end()) {
+                    it->second.value += counter.value;
+                } else {
+                    counters.emplace_back(name, counter);
+                }
+            }
+            statistics.merge(state.statistics());
+            histogram.merge(state.histogram());
+            samples.insert(samples.end(), state.samples().begin(), state.samples().end());
+            const std::vector<uint64_t> totals = state.perf_counter_totals();
+            perf_counter_totals.resize(std::max(perf_counter_totals.size(), totals.size()));
+            for (size_t index = 0; index < totals.size(); ++index) {
+                perf_counter_totals[index] += totals[index];
+            }
+            if (state.completed_iterations() > 0) {
+                first_start = std::min(first_start, state.first_start_ticks());
+                last_stop = std::max(last_stop, state.last_stop_ticks());
+                untimed = std::max(untimed, state.untimed_ticks());
+                ns_per_tick = state.ns_per_tick();
+            }
+        }
+        // Cache evictions overlap across threads, the longest stands for all of them.
+        if (last_stop - untimed > first_start) {
+            wall_ns = static_cast<double>(last_stop - first_start - untimed) * ns_per_tick;
+        }
+    }
+
+    [[nodiscard]] double mean_iteration_ns() const
+    {
+        return (iterations > 0) ? elapsed_ns / static_cast<double>(iterations) : 0.0;
+    }
+
+    // Average timed region of one thread.
+    [[nodiscard]] double thread_elapsed_ns() const
+    {
+        return (threads > 0) ? elapsed_ns / threads : 0.0;
+    }
+
+    [[nodiscard]] double pauses_per_iteration() const
+    {
+        return (iterations > 0) ? static_cast<double>(pauses) / static_cast<double>(iterations)
+                                : 0.0;
+    }
+};
+
+} // namespace detail
+
+// Process-wide list of the benchmarks registered with USCOPE_BENCHMARK. Registration links static
+// nodes and never allocates.
+class BenchmarkRegistry {
+public:
+    static BenchmarkRegistry& instance()
+    {
+        static constinit BenchmarkRegistry registry;
+        return registry;
+    }
+
+    Benchmark& add(Benchmark& benchmark)
+    {
+        benchmarks_.push_back(benchmark);
+        return benchmark;
+    }
+
+    [[nodiscard]] const BenchmarkList& benchmarks() const
+    {
+        return benchmarks_;
+    }
+
+private:
+    constexpr BenchmarkRegistry() = default;
+
+    BenchmarkList benchmarks_;
+};
+
+namespace detail {
+
+// Entry index of a comma-separated list of types as spelled by the preprocessor, ignoring the
+// commas nested in template arguments.
+constexpr std::string_view type_list_entry(std::string_view list, size_t index)
+{
+    size_t begin = 0;
+    int depth = 0;
+    for (size_t position = 0; position <= list.size(); ++position) {
+        const char c = (position < list.size()) ? list[position] : ',';
+        if (c == '<' || c == '(') {
+            ++depth;
+        } else if (c == '>' || c == ')') {
+            --depth;
+        } else if (c == ',' && depth == 0) {
+            if (index-- == 0) {
+                std::string_view entry = list.substr(begin, position - begin);
+                while (!entry.empty() && entry.front() == ' ') {
+                    entry.remove_prefix(1);
+                }
+                while (!entry.empty() && entry.back() == ' ') {
+                    entry.remove_suffix(1);
+                }
+                return entry;
+            }
+            begin = position + 1;
+        }
+    }
+    return {};
+}
+
+template<typename Kernel, typename Type>
+void run_typed_kernel(BenchmarkState& state)
+{
+    Kernel::template run<Type>(state);
+}
+
+template<BenchmarkFixture F, auto Function>
+    requires std::invocable<decltype(Function), F&, BenchmarkState&>
+void run_fixture(BenchmarkState& state)
+{
+    F fixture;
+    fixture.setup(state);
+    std::invoke(Function, fixture, state);
+    fixture.teardown(state);
+}
+
+template<auto Function>
+    requires AsyncBenchmarkFunction<decltype(Function)>
+void run_async(BenchmarkState& state)
+{
+    Executor executor;
+    executor.run(std::invoke(Function, state));
+}
+
+template<auto Function, StaticConfig Options>
+    requires StaticBenchmarkFunction<decltype(Function), Options>
+void run_static(BenchmarkState& state)
+{
+    if constexpr (std::invocable<decltype(Function), StaticState<Options>&>) {
+        StaticState<Options> static_state(state);
+        std::invoke(Function, static_state);
+    } else {
+        std::invoke(Function, state);
+    }
+}
+
+// Kernel is unique to each registration, so the nodes of every registration are distinct statics.
+template<typename Kernel, typename... Types>
+BenchmarkGroup register_typed_benchmarks(std::string_view name, std::string_view type_list)
+{
+    size_t index = 0;
+    static std::array<Benchmark, sizeof...(Types)> benchmarks {
+        Benchmark {
+            name,
+            type_list_entry(type_list, index++),
+            &run_typed_kernel<Kernel, Types>,
+        }...,
+    };
+    for (auto& benchmark : benchmarks) {
+        BenchmarkRegistry::instance().add(benchmark);
+    }
+    return BenchmarkGroup { benchmarks };
+}
+
+} // namespace detail
+
+// The distribution merges the samples of every thread. iterations_per_second is the aggregate
+// throughput of all threads over the window from the first thread start to the last thread stop.
+struct BenchmarkResult {
+    std::string name;
+    std::vector<Argument> arguments;
+    int threads;
+    // Union of the CPUs the threads were allowed to run on, as a list like "0-3,8".
+    std::string affinity;
+    double iterations_per_second;
+    Iteration iterations;
+    double raw_time_ns;
+    double time_ns;
+    // keep_running() overhead plus the residual of the pause/resume pairs of an average iteration.
+    double overhead_ns;
+    double pauses_per_iteration;
+    // Heap allocations and allocated bytes per iteration in the timed region, with
+    // USCOPE_TRACK_ALLOCATIONS.
+    double allocations_per_iteration;
+    double allocated_bytes_per_iteration;
+    bool unreliable;
+    // Why the run failed, as when it allocated while Benchmark::forbid_allocations() was set.
+    std::string error;
+    double stddev_ns;
+    double min_ns;
+    double p50_ns;
+    double p90_ns;
+    double p99_ns;
+    double p999_ns;
+    double max_ns;
+    // Config::perf_counters per iteration, followed by IPC when cycles and instructions are both
+    // counted.
+    std::vector<std::pair<std::string, double>> perf_counters;
+    // User counters with their flags applied.
+    std::vector<std::pair<std::string, Counter>> counters;
+    // Non-empty buckets of the per-iteration time histogram, without the overhead subtracted.
+    std::vector<HistogramBucket> histogram;
+    // Empty unless the run used SampleStorage::Raw.
+    std::vector<Sample> samples;
+    Outliers outliers;
+    // Index among the Config::repetitions of the run.
+    int repetition;
+    // Empty for a run, else mean, median, stddev, cv or min: the statistic of every value over the
+    // repetitions of the run, with iterations the number of repetitions. BigO and RMS results hold
+    // the coefficient and the relative RMS of the complexity fit of a family in time_ns.
+    std::string aggregate;
+    Argument complexity_n;
+    Complexity complexity;
+};
+
+namespace detail {
+
+inline double aggregate_values(std::vector<double> values, std::string_view aggregate)
+{
+    if (aggregate == "median") {
+        const auto middle = values.begin() + static_cast<std::ptrdiff_t>(values.size() / 2);
+        std::ranges::nth_element(values, middle);
+        if (values.size() % 2 == 1) {
+            return *middle;
+        }
+        return (*middle + *std::max_element(values.begin(), middle)) / 2.0;
+    }
+    RunningStatistics statistics;
+    for (const double value : values) {
+        statistics.add(value);
+    }
+    if (aggregate == "stddev") {
+        return statistics.stddev();
+    }
+    if (aggregate == "cv") {
+        return (statistics.mean() != 0.0) ? statistics.stddev() / statistics.mean() : 0.0;
+    }
+    if (aggregate == "min") {
+        return statistics.min();
+    }
+    return statistics.mean();
+}
+
+inline std::vector<BenchmarkResult> aggregate_repetitions(
+    std::span<const BenchmarkResult> repetitions)
+{
+    static constexpr std::array kAggregates { "mean", "median", "stddev", "cv", "min" };
+    static constexpr std::array kFields {
+        &BenchmarkResult::iterations_per_second,
+        &BenchmarkResult::raw_time_ns,
+        &BenchmarkResult::time_ns,
+        &BenchmarkResult::overhead_ns,
+        &BenchmarkResult::pauses_per_iteration,
+        &BenchmarkResult::allocations_per_iteration,
+        &BenchmarkResult::allocated_bytes_per_iteration,
+        &BenchmarkResult::stddev_ns,
+        &BenchmarkResult::min_ns,
+        &BenchmarkResult::p50_ns,
+        &BenchmarkResult::p90_ns,
+        &BenchmarkResult::p99_ns,
+        &BenchmarkResult::p999_ns,
+        &BenchmarkResult::max_ns,
+    };
+    std::vector<BenchmarkResult> aggregates;
+    if (repetitions.size() < 2) {
+        return aggregates;
+    }
+    const auto collect = [&](auto&& value_of) {
+        std::vector<double> values;
+        values.reserve(repetitions.size());
+        for (const BenchmarkResult& repetition : repetitions) {
+            values.push_back(value_of(repetition));
+        }
+        return values;
+    };
+    for (const std::string_view aggregate : kAggregates) {
+        BenchmarkResult& result = aggregates.emplace_back(repetitions.front());
+        result.name += '_';
+        result.name += aggregate;
+        result.aggregate = aggregate;
+        result.iterations = static_cast<Iteration>(repetitions.size());
+        result.histogram.clear();
+        result.samples.clear();
+        result.outliers = {};
+        result.unreliable = std::ranges::any_of(repetitions, &BenchmarkResult::unreliable);
+        const auto failed = std::ranges::find_if_not(
+            repetitions,
+            &std::string::empty,
+            &BenchmarkResult::error);
+        if (failed != repetitions.end()) {
+            result.error = failed->error;
+        }
+        for (const auto field : kFields) {
+            result.*field = aggregate_values(
+                collect([&](const BenchmarkResult& repetition) { return repetition.*field; }),
+                aggregate);
+        }
+        // Counters line up when the repetitions set the same ones, which they normally do.
+        for (size_t index = 0; index < result.perf_counters.size(); ++index) {
+            result.perf_counters[index].second = aggregate_values(
+                collect([&](const BenchmarkResult& repetition) {
+                    return (index < repetition.perf_counters.size())
+                        ? repetition.perf_counters[index].second
+                        : 0.0;
+                }),
+                aggregate);
+        }
+        for (size_t index = 0; index < result.counters.size(); ++index) {
+            result.counters[index].second.value = aggregate_values(
+                collect([&](const BenchmarkResult& repetition) {
+                    return (index < repetition.counters.size())
+                        ? repetition.counters[index].second.value
+                        : 0.0;
+                }),
+                aggregate);
+        }
+    }
+    return aggregates;
+}
+
+} // namespace detail
+
+template<std::integral Integer>
+static inline size_t count_digits(Integer n)
+{
+    size_t result = 1;
+    if (n < 0) {
+        n = (n == std::numeric_limits<Integer>::min()) ? std::numeric_limits<Integer>::max() : -n;
+    }
+    while (n > 9) {
+        n /= 10;
+        result++;
+    }
+    return result;
+}
+
+namespace detail {
+
+inline void append_number(std::string& out, double value)
+{
+    std::array<char, 32> scratch {};
+    const auto result = std::to_chars(scratch.data(), scratch.data() + scratch.size(), value);
+    out.append(scratch.data(), result.ptr);
+}
+
+template<std::integral Integer>
+void append_number(std::string& out, Integer value)
+{
+    std::array<char, 24> scratch {};
+    const auto result = std::to_chars(scratch.data(), scratch.data() + scratch.size(), value);
+    out.append(scratch.data(), result.ptr);
+}
+
+inline void append_json_string(std::string& out, std::string_view text)
+{
+    static constexpr std::string_view kHexDigits = "0123456789abcdef";
+    out += '"';
+    for (const char c : text) {
+        switch (c) {
+        case '"':
+            out += "\\\"";
+            break;
+        case '\\':
+            out += "\\\\";
+            break;
+        case '\n':
+            out += "\\n";
+            break;
+        case '\t':
+            out += "\\t";
+            break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                out += "\\u00";
+                out += kHexDigits[static_cast<unsigned char>(c) >> 4];
+                out += kHexDigits[static_cast<unsigned char>(c) & 0xf];
+            } else {
+                out += c;
+            }
+        }
+    }
+    out += '"';
+}
+
+// JSON has no representation for infinities and NaNs.
+inline void append_json_number(std::string& out, double value)
+{
+    if (std::isfinite(value)) {
+        append_number(out, value);
+    } else {
+        out += "null";
+    }
+}
+
+inline void append_csv_field(std::string& out, std::string_view text)
+{
+    if (text.find_first_of(",\"\n") == std::string_view::npos) {
+        out += text;
+        return;
+    }
+    out += '"';
+    for (const char c : text) {
+        if (c == '"') {
+            out += '"';
+        }
+        out += c;
+    }
+    out += '"';
+}
+
+inline void write_all(std::FILE* out, const std::string& buffer)
+{
+    std::fwrite(buffer.data(), 1, buffer.size(), out);
+    std::fflush(out);
+}
+
+} // namespace detail
+
+// Machine and build the results were measured on.
+struct SystemInfo {
+    std::string host_name;
+    std::string cpu_model;
+    int cpu_count { 0 };
+    // Governor of cpu0 as cpufreq reports it, "performance" meaning no frequency scaling.
+    std::string frequency_scaling;
+    std::string compiler;
+    // "optimized" or "debug", then ", NDEBUG" when assertions are disabled.
+    std::string build;
+    // USCOPE_COMPILE_FLAGS, when the build defines it to the compiler flags.
+    std::string flags;
+};
+
+namespace detail {
+
+inline std::string utc_date()
+{
+    using namespace std::chrono;
+    const auto now = floor<seconds>(system_clock::now());
+    const auto day = floor<days>(now);
+    const year_month_day date { day };
+    const hh_mm_ss time { now - day };
+    std::array<char, 32> text {};
+    std::snprintf(
+        text.data(),
+        text.size(),
+        "%04d-%02u-%02uT%02d:%02d:%02dZ",
+        static_cast<int>(date.year()),
+        static_cast<unsigned>(date.month()),
+        static_cast<unsigned>(date.day()),
+        static_cast<int>(time.hours().count()),
+        static_cast<int>(time.minutes().count()),
+        static_cast<int>(time.seconds().count()));
+    return text.data();
+}
+
+} // namespace detail
+
+// Probed once per process.
+inline const SystemInfo& system_info()
+{
+    static const SystemInfo info = [] {
+        SystemInfo system;
+        system.cpu_count = static_cast<int>(std::thread::hardware_concurrency());
+#if defined(__linux__)
+        std::array<char, 256> host {};
+        if (gethostname(host.data(), host.size() - 1) == 0) {
+            system.host_name = host.data();
+        }
+        system.cpu_model = detail::read_text_line("/proc/cpuinfo", "model name");
+        if (system.cpu_model.empty()) {
+            system.cpu_model = detail::read_text_line("/proc/cpuinfo", "Hardware");
+        }
+        system.frequency_scaling
+            = detail::read_text_line("/sys/devices/system/cpu/cpu0/cpufreq/scaling_governor");
+#endif
+#if defined(__clang__)
+        system.compiler = "clang " __clang_version__;
+#elif defined(__GNUC__)
+        system.compiler = "gcc " __VERSION__;
+#elif defined(_MSC_VER)
+        system.compiler = "msvc " + std::to_string(_MSC_FULL_VER);
+#endif
+#if defined(__OPTIMIZE__) || (defined(_MSC_VER) && !defined(_DEBUG))
+        system.build = "optimized";
+#else
+        system.build = "debug";
+#endif
+#if defined(NDEBUG)
+        system.build += ", NDEBUG";
+#endif
+#if defined(USCOPE_COMPILE_FLAGS)
+        system.flags = USCOPE_COMPILE_FLAGS;
+#endif
+        return system;
+    }();
+    return info;
+}
+
+// State of the machine that makes timings noisy or not comparable with other runs, probed before
+// every run. Fields the platform does not expose are left empty or unknown.
+struct Environment {
+    // Distinct scaling governors of the CPUs, comma-separated.
+    std::string governors;
+    std::optional<bool> turbo;
+    std::optional<bool> smt;
+    std::string isolated_cpus;
+    std::string nohz_full_cpus;
+    // Over the last minute, negative when unknown.
+    double load_average { -1.0 };
+    // randomize_va_space: 0 for off, 2 for the stack, libraries and heap. Negative when unknown.
+    int aslr { -1 };
+    // Current clock rate, estimated from a chain of dependent additions of one cycle each.
+    double reference_ghz { 0.0 };
+    // How much slower than its fastest round the median round of that chain is, relative to it.
+    // The median leaves out the rare preemptions that say little about the steady noise.
+    double noise { 0.0 };
+    // Everything above that makes the machine unfit for benchmarking.
+    std::vector<std::string> warnings;
+};
+
+namespace detail {
+
+constexpr int kReferenceAdds = 256;
+
+// Dependent additions in assembly, so that their count does not depend on the optimization level.
+// The increment is a register, as recent cores fold additions of immediates at rename.
+USCOPE_ALWAYS_INLINE void reference_adds(uint64_t& value)
+{
+    [[maybe_unused]] const uint64_t increment = 1;
+#if (defined(__GNUC__) || defined(__clang__)) && defined(USCOPE_ARCH_X86)
+    asm volatile(".rept 256\n\taddq %1, %0\n\t.endr" : "+r"(value) : "r"(increment));
+#elif (defined(__GNUC__) || defined(__clang__)) && defined(USCOPE_ARCH_AARCH64)
+    asm volatile(".rept 256\n\tadd %0, %0, %1\n\t.endr" : "+r"(value) : "r"(increment));
+#else
+    for (int index = 0; index < kReferenceAdds; ++index) {
+        ++value;
+        do_not_optimize(value);
+    }
+#endif
+}
+
+// Clock rate from the fastest round, noise from the median one, after a round of warm-up. About
+// 2 ms.
+inline void measure_reference_loop(Environment& environment)
+{
+    static constexpr size_t kRounds = 33;
+    static constexpr int kBlocksPerRound = 512;
+
+    std::array<double, kRounds> rounds {};
+    uint64_t value = 0;
+    for (double& round : rounds) {
+        const auto start = std::chrono::steady_clock::now();
+        for (int block = 0; block < kBlocksPerRound; ++block) {
+            reference_adds(value);
+        }
+        const std::chrono::duration<double, std::nano> elapsed
+            = std::chrono::steady_clock::now() - start;
+        round = elapsed.count();
+    }
+    do_not_optimize(value);
+    const std::span<double> measured = std::span(rounds).subspan(1);
+    std::ranges::sort(measured);
+    const double fastest = measured.front();
+    if (fastest > 0.0) {
+        environment.reference_ghz = kBlocksPerRound * kReferenceAdds / fastest;
+        environment.noise = measured[measured.size() / 2] / fastest - 1.0;
+    }
+}
+
+inline std::optional<bool> read_flag(const char* path)
+{
+    const std::string value = read_text_line(path);
+    if (value.empty()) {
+        return std::nullopt;
+    }
+    return value != "0";
+}
+
+} // namespace detail
+
+inline Environment probe_environment()
+{
+    static constexpr double kMaxNoise = 0.05;
+    static constexpr double kMaxLoadPerCpu = 0.1;
+
+    Environment environment;
+    const SystemInfo& system = system_info();
+#if defined(__linux__)
+    std::vector<std::string> governors;
+    for (int cpu = 0; cpu < system.cpu_count; ++cpu) {
+        const std::string path
+            = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/cpufreq/scaling_governor";
+        std::string governor = detail::read_text_line(path.c_str());
+        if (!governor.empty() && std::ranges::find(governors, governor) == governors.end()) {
+            governors.push_back(std::move(governor));
+        }
+    }
+    for (const std::string& governor : governors) {
+        environment.governors += environment.governors.empty() ? "" : ",";
+        environment.governors += governor;
+        if (governor != "performance") {
+            environment.warnings.push_back("scaling governor " + governor);
+        }
+    }
+    if (const std::optional<bool> no_turbo
+        = detail::read_flag("/sys/devices/system/cpu/intel_pstate/no_turbo")) {
+        environment.turbo = !*no_turbo;
+    } else {
+        environment.turbo = detail::read_flag("/sys/devices/system/cpu/cpufreq/boost");
+    }
+    if (environment.turbo.value_or(false)) {
+        environment.warnings.emplace_back("turbo boost enabled");
+    }
+    environment.smt = detail::read_flag("/sys/devices/system/cpu/smt/active");
+    if (environment.smt.value_or(false)) {
+        environment.warnings.emplace_back("SMT active");
+    }
+    environment.isolated_cpus = detail::read_text_line("/sys/devices/system/cpu/isolated");
+    environment.nohz_full_cpus = detail::read_text_line("/sys/devices/system/cpu/nohz_full");
+    const std::string load = detail::read_text_line("/proc/loadavg");
+    double load_average = 0.0;
+    if (std::from_chars(load.data(), load.data() + load.size(), load_average).ec == std::errc {}) {
+        environment.load_average = load_average;
+        const double max_load = std::max(1.0, kMaxLoadPerCpu * system.cpu_count);
+        if (load_average > max_load) {
+            std::string warning = "load average ";
+            detail::append_number(warning, load_average);
+            environment.warnings.push_back(std::move(warning));
+        }
+    }
+    const std::string aslr = detail::read_text_line("/proc/sys/kernel/randomize_va_space");
+    if (!aslr.empty()) {
+        environment.aslr = std::atoi(aslr.c_str());
+        if (environment.aslr != 0) {
+            environment.warnings.emplace_back("ASLR enabled");
+        }
+    }
+#endif
+    detail::measure_reference_loop(environment);
+    if (environment.noise > kMaxNoise) {
+        std::string warning = "noise floor ";
+        detail::append_number(warning, environment.noise * 100.0);
+        environment.warnings.push_back(warning + "%");
+    }
+    return environment;
+}
+
+// What every result of one BenchmarkRunner run was measured with, reported before the results.
+struct RunContext {
+    SystemInfo system;
+    Environment environment;
+    ClockSource clock;
+    TimingOverhead overhead;
+    Iteration batch_size;
+    bool subtract_overhead;
+    bool allocation_tracking;
+    // Widest benchmark name and iteration count of the run, for aligning columns.
+    size_t name_width;
+    size_t iterations_width;
+};
+
+// The context as key and value strings, in the order the machine-readable reporters write them.
+inline std::vector<std::pair<std::string, std::string>> context_entries(const RunContext& context)
+{
+    const ClockInfo& clock = clock_info(context.clock);
+    const Environment& environment = context.environment;
+    const auto number = [](double value) {
+        std::string text;
+        detail::append_number(text, value);
+        return text;
+    };
+    const auto flag = [](std::optional<bool> value) -> std::string {
+        return value ? (*value ? "true" : "false") : "";
+    };
+    std::string warnings;
+    for (const std::string& warning : environment.warnings) {
+        warnings += warnings.empty() ? "" : "; ";
+        warnings += warning;
+    }
+    return {
+        { "date", detail::utc_date() },
+        { "host_name", context.system.host_name },
+        { "cpu_model", context.system.cpu_model },
+        { "num_cpus", std::to_string(context.system.cpu_count) },
+        { "cpu_scaling", context.system.frequency_scaling },
+        { "compiler", context.system.compiler },
+        { "build", context.system.build },
+        { "flags", context.system.flags },
+        { "clock", std::string(clock.name) },
+        { "clock_ns_per_tick", number(clock.ns_per_tick) },
+        { "clock_resolution_ns", number(clock.resolution_ns) },
+        { "clock_overhead_ns", number(clock.overhead_ns) },
+        { "batch_size", std::to_string(context.batch_size) },
+        { "keep_running_overhead_ns", number(context.overhead.keep_running_ns) },
+        { "pause_resume_overhead_ns", number(context.overhead.pause_resume_ns) },
+        { "overhead_subtracted", context.subtract_overhead ? "true" : "false" },
+        { "allocation_tracking", context.allocation_tracking ? "true" : "false" },
+        { "governors", environment.governors },
+        { "turbo", flag(environment.turbo) },
+        { "smt", flag(environment.smt) },
+        { "isolated_cpus", environment.isolated_cpus },
+        { "nohz_full_cpus", environment.nohz_full_cpus },
+        { "load_average",
+          (environment.load_average >= 0.0) ? number(environment.load_average) : "" },
+        { "aslr", (environment.aslr >= 0) ? std::to_string(environment.aslr) : "" },
+        { "reference_clock_ghz", number(environment.reference_ghz) },
+        { "noise_floor", number(environment.noise) },
+        { "environment_warnings", warnings },
+    };
+}
+
+class Reporter {
+public:
+    Reporter() = default;
+    Reporter(const Reporter&) = delete;
+    Reporter& operator=(const Reporter&) = delete;
+    virtual ~Reporter() = default;
+
+    virtual void report_context(const RunContext& context) = 0;
+    // Called as soon as each benchmark has run.
+    virtual void report_run(const BenchmarkResult& result) = 0;
+    virtual void finalize() {}
+};
+
+// Aligned columns in the layout of Google Benchmark's console reporter. Each line is formatted into
+// a reused buffer with std::to_chars and written with a single flush.
+class ConsoleReporter : public Reporter {
+public:
+    enum class Colors : uint8_t {
+        // When the output is a terminal and NO_COLOR is not set.
+        Auto,
+        Always,
+        Never,
+    };
+
+    explicit ConsoleReporter(std::FILE* out = stdout, Colors colors = Colors::Auto)
+        : out_(out)
+        , colors_(use_colors(out, colors))
+    {
+        buffer_.reserve(kInitialBufferSize);
+    }
+
+    void report_context(const RunContext& context) override
+    {
+        context_ = context;
+        buffer_.clear();
+        const ClockInfo& selected = clock_info(context.clock);
+        append("Run on ");
+        append(context.system.host_name.empty() ? "unknown host" : context.system.host_name);
+        append(": ");
+        append_integer(context.system.cpu_count);
+        append(" x ");
+        append(context.system.cpu_model.empty() ? "unknown CPU" : context.system.cpu_model);
+        if (!context.system.frequency_scaling.empty()) {
+            append(", scaling governor ");
+            append(context.system.frequency_scaling);
+        }
+        append_environment(context.environment);
+        append("Clocks:\n");
+        const auto append_clock = [&](const ClockInfo& info) {
+            append((info.name == selected.name) ? "  * " : "    ");
+            append_left(info.name, kClockNameWidth);
+            append(" resolution ");
+            append_fixed(info.resolution_ns, 3, 8);
+            append(" ns, overhead ");
+            append_fixed(info.overhead_ns, 3, 8);
+            append(" ns\n");
+        };
+        append_clock(clock_info(ClockSource::Steady));
+        if (CycleCounterClock::available) {
+            append_clock(clock_info(ClockSource::CycleCounter));
+        }
+        append("keep_running() overhead: ");
+        append_fixed(context.overhead.keep_running_ns, 3);
+        append(" ns/iteration (batch size ");
+        append_integer(context.batch_size);
+        append("), pause/resume ");
+        append_fixed(context.overhead.pause_resume_ns, 3);
+        append(" ns/pair");
+        append(context.subtract_overhead ? ", subtracted from results\n" : "\n");
+
+        const size_t start = buffer_.size();
+        append_left("Benchmark", context.name_width + 1);
+        append_right("Time", kTimeWidth + kUnitWidth);
+        append_right("Iterations", iterations_width() + 1);
+        if (context.allocation_tracking) {
+            append_right("Allocs", kAllocationWidth + 1);
+            append_right("Bytes", kAllocationWidth + 1);
+        }
+        append_right("Rate", kRateWidth + 1);
+        for (const std::string_view quantile : { "p50", "p90", "p99", "p99.9", "Overhead" }) {
+            append_right(quantile, kTimeWidth + 1);
+        }
+        append("  CPUs\n");
+        buffer_.append(buffer_.size() - start - 1, '-');
+        append("\n");
+        flush();
+    }
+
+    void report_run(const BenchmarkResult& result) override
+    {
+        buffer_.clear();
+        set_color(Color::Green);
+        append_left(result.name, context_.name_width + 1);
+        if (result.aggregate == "BigO" || result.aggregate == "RMS") {
+            set_color(Color::Yellow);
+            if (result.aggregate == "BigO") {
+                // Two significant digits, coefficients of N^3 are often far below 1 ns.
+                append_chars(kTimeWidth, result.time_ns, std::chars_format::general, 2);
+                append(" ");
+                append(complexity_string(result.complexity));
+            } else {
+                append_fixed(result.time_ns * 100.0, 0, kTimeWidth);
+                append(" %");
+            }
+            set_color(Color::Default);
+            append("\n");
+            flush();
+            return;
+        }
+        // The coefficient of variation is a ratio, printed as a percentage in the time columns.
+        const bool percentage = result.aggregate == "cv";
+        const auto append_value = [&](double value) {
+            if (percentage) {
+                append_fixed(value * 100.0, 2, kTimeWidth);
+            } else {
+                append_time(value);
+            }
+        };
+        set_color(Color::Yellow);
+        append_value(result.time_ns);
+        append(percentage ? " % " : " ns");
+        set_color(Color::Cyan);
+        append_right_integer(result.iterations, iterations_width() + 1);
+        if (context_.allocation_tracking) {
+            set_color(result.error.empty() ? Color::Default : Color::Red);
+            append(" ");
+            append_human_readable(
+                result.allocations_per_iteration,
+                Counter::OneK::Is1000,
+                "",
+                kAllocationWidth);
+            append(" ");
+            append_human_readable(
+                result.allocated_bytes_per_iteration,
+                Counter::OneK::Is1024,
+                "B",
+                kAllocationWidth);
+        }
+        set_color(Color::Default);
+        append(" ");
+        if (percentage) {
+            append_fixed(result.iterations_per_second * 100.0, 2, kRateWidth - 2);
+            append(" %");
+        } else {
+            append_human_readable(
+                result.iterations_per_second,
+                Counter::OneK::Is1000,
+                "/s",
+                kRateWidth);
+        }
+        for (const double time :
+             { result.p50_ns, result.p90_ns, result.p99_ns, result.p999_ns, result.overhead_ns }) {
+            append(" ");
+            append_value(time);
+        }
+        append("  ");
+        append(result.affinity);
+        for (const auto& [name, value] : result.perf_counters) {
+            append(" ");
+            append(name);
+            append("=");
+            append_human_readable(value, Counter::OneK::Is1000, (name == "IPC") ? "" : "/iter");
+        }
+        for (const auto& [name, counter] : result.counters) {
+            const bool invert = (counter.flags & Counter::Invert) != 0;
+            const std::string_view unit
+                = ((counter.flags & Counter::Rate) != 0) ? (invert ? "s" : "/s") : "";
+            append(" ");
+            append(name);
+            append("=");
+            append_human_readable(counter.value, counter.one_k, unit);
+        }
+        if (result.outliers.total() > 0) {
+            append_outliers(result.outliers);
+        }
+        if (result.unreliable) {
+            append(" ");
+            set_color(Color::Red);
+            append("UNRELIABLE: close to the timing overhead");
+            set_color(Color::Default);
+        }
+        if (!result.error.empty()) {
+            append(" ");
+            set_color(Color::Red);
+            append("FAILED: ");
+            append(result.error);
+            set_color(Color::Default);
+        }
+        append("\n");
+        flush();
+    }
+
+private:
+    enum class Color : uint8_t {
+        Default,
+        Red,
+        Green,
+        Yellow,
+        Cyan,
+    };
+
+    void append_environment(const Environment& environment)
+    {
+        const auto append_flag = [&](std::string_view name, std::optional<bool> value) {
+            if (value) {
+                append(", ");
+                append(name);
+                append(*value ? " on" : " off");
+            }
+        };
+        append("\nEnvironment: ~");
+        append_fixed(environment.reference_ghz, 2);
+        append(" GHz, noise ");
+        append_fixed(environment.noise * 100.0, 2);
+        append(" %");
+        append_flag("turbo", environment.turbo);
+        append_flag("SMT", environment.smt);
+        if (environment.load_average >= 0.0) {
+            append(", load ");
+            append_fixed(environment.load_average, 2);
+        }
+        if (environment.aslr >= 0) {
+            append(environment.aslr == 0 ? ", ASLR off" : ", ASLR on");
+        }
+        if (!environment.isolated_cpus.empty()) {
+            append(", isolated CPUs ");
+            append(environment.isolated_cpus);
+        }
+        if (!environment.nohz_full_cpus.empty()) {
+            append(", nohz_full CPUs ");
+            append(environment.nohz_full_cpus);
+        }
+        append("\n");
+        for (const std::string& warning : environment.warnings) {
+            set_color(Color::Yellow);
+            append("WARNING: ");
+            append(warning);
+            set_color(Color::Default);
+            append("\n");
+        }
+    }
+
+    static constexpr size_t kInitialBufferSize = 512;
+    static constexpr size_t kClockNameWidth = 14;
+    // Ten characters for the number as Google Benchmark does, then the unit.
+    static constexpr size_t kTimeWidth = 10;
+    static constexpr size_t kUnitWidth = 3;
+    static constexpr size_t kRateWidth = 10;
+    // Allocations and allocated bytes per iteration.
+    static constexpr size_t kAllocationWidth = 8;
+
+    static bool use_colors(std::FILE* out, Colors colors)
+    {
+        if (colors != Colors::Auto) {
+            return colors == Colors::Always;
+        }
+#if defined(__linux__)
+        const char* term = std::getenv("TERM");
+        return std::getenv("NO_COLOR") == nullptr && isatty(fileno(out)) != 0
+            && (term == nullptr || std::string_view(term) != "dumb");
+#else
+        (void)out;
+        return false;
+#endif
+    }
+
+    // As criterion words it: outliers 3/100 (3.0%): 2 high mild, 1 high severe.
+    void append_outliers(const Outliers& outliers)
+    {
+        append(" outliers ");
+        append_integer(static_cast<int64_t>(outliers.total()));
+        append("/");
+        append_integer(static_cast<int64_t>(outliers.samples));
+        append(" (");
+        append_fixed(
+            100.0 * static_cast<double>(outliers.total()) / static_cast<double>(outliers.samples),
+            1);
+        append("%):");
+        const char* separator = " ";
+        for (const auto& [count, kind] : {
+                 std::pair { outliers.low_severe, "low severe" },
+                 std::pair { outliers.low_mild, "low mild" },
+                 std::pair { outliers.high_mild, "high mild" },
+                 std::pair { outliers.high_severe, "high severe" },
+             }) {
+            if (count > 0) {
+                append(separator);
+                append_integer(static_cast<int64_t>(count));
+                append(" ");
+                append(kind);
+                separator = ", ";
+            }
+        }
+    }
+
+    [[nodiscard]] size_t iterations_width() const
+    {
+        return std::max(context_.iterations_width, std::string_view("Iterations").size());
+    }
+
+    void set_color(Color color)
+    {
+        if (!colors_) {
+            return;
+        }
+        switch (color) {
+        case Color::Default:
+            append("\033[m");
+            break;
+        case Color::Red:
+            append("\033[0;31m");
+            break;
+        case Color::Green:
+            append("\033[0;32m");
+            break;
+        case Color::Yellow:
+            append("\033[0;33m");
+            break;
+        case Color::Cyan:
+            append("\033[0;36m");
+            break;
+        }
+    }
+
+    void append(std::string_view text)
+    {
+        buffer_.append(text);
+    }
+
+    void append_left(std::string_view text, size_t width)
+    {
+        buffer_.append(text);
+        if (text.size() < width) {
+            buffer_.append(width - text.size(), ' ');
+        }
+    }
+
+    void append_right(std::string_view text, size_t width)
+    {
+        if (text.size() < width) {
+            buffer_.append(width - text.size(), ' ');
+        }
+        buffer_.append(text);
+    }
+
+    template<typename... Args>
+    void append_chars(size_t width, Args... args)
+    {
+        std::array<char, 64> scratch {};
+        const auto result = std::to_chars(scratch.data(), scratch.data() + scratch.size(), args...);
+        append_right(std::string_view(scratch.data(), result.ptr), width);
+    }
+
+    void append_integer(int64_t value)
+    {
+        append_chars(0, value);
+    }
+
+    void append_right_integer(int64_t value, size_t width)
+    {
+        append_chars(width, value);
+    }
+
+    void append_fixed(double value, int precision, size_t width = 0)
+    {
+        append_chars(width, value, std::chars_format::fixed, precision);
+    }
+
+    // Aligns the decimal points of times up to 9999999999 in ten characters, as
+    // Google Benchmark's FormatTime does.
+    void append_time(double time)
+    {
+        if (time > 9999999999.0) {
+            append_chars(kTimeWidth, time, std::chars_format::scientific, 4);
+            return;
+        }
+        const int precision = (time < 1.0) ? 3 : (time < 10.0) ? 2 : (time < 100.0) ? 1 : 0;
+        append_fixed(time, precision, kTimeWidth);
+    }
+
+    void append_human_readable(
+        double value,
+        Counter::OneK one_k,
+        std::string_view unit,
+        size_t width = 0)
+    {
+        std::array<char, 64> scratch {};
+        char* end = to_chars_human_readable(
+            scratch.data(),
+            scratch.data() + scratch.size() - unit.size(),
+            value,
+            one_k);
+        end = std::copy(unit.begin(), unit.end(), end);
+        append_right(std::string_view(scratch.data(), end), width);
+    }
+
+    void flush()
+    {
+        std::fwrite(buffer_.data(), 1, buffer_.size(), out_);
+        std::fflush(out_);
+    }
+
+    std::FILE* out_;
+    bool colors_;
+    RunContext context_ {};
+    std::string buffer_;
+};
+
+// One document per run of a BenchmarkRunner, {"context": {...}, "benchmarks": [...]}, with each
+// benchmark written as soon as it has run. Raw samples are left to BinaryReporter.
+class JsonReporter : public Reporter {
+public:
+    explicit JsonReporter(std::FILE* out)
+        : out_(out)
+    {
+    }
+
+    void report_context(const RunContext& context) override
+    {
+        buffer_ = "{\n  \"context\": {";
+        const char* separator = "\n";
+        for (const auto& [key, value] : context_entries(context)) {
+            buffer_ += separator;
+            buffer_ += "    ";
+            detail::append_json_string(buffer_, key);
+            buffer_ += ": ";
+            detail::append_json_string(buffer_, value);
+            separator = ",\n";
+        }
+        buffer_ += "\n  },\n  \"benchmarks\": [";
+        first_run_ = true;
+        detail::write_all(out_, buffer_);
+    }
+
+    void report_run(const BenchmarkResult& result) override
+    {
+        buffer_ = first_run_ ? "\n    {" : ",\n    {";
+        first_run_ = false;
+        separator_ = "\n";
+        add_string("name", result.name);
+        key("arguments");
+        buffer_ += '[';
+        for (size_t index = 0; index < result.arguments.size(); ++index) {
+            buffer_ += (index > 0) ? ", " : "";
+            detail::append_number(buffer_, result.arguments[index]);
+        }
+        buffer_ += ']';
+        add_number("threads", result.threads);
+        add_number("repetition", result.repetition);
+        if (!result.aggregate.empty()) {
+            add_string("aggregate", result.aggregate);
+        }
+        if (result.aggregate == "BigO") {
+            add_string("complexity", complexity_string(result.complexity));
+        }
+        add_number("complexity_n", result.complexity_n);
+        add_string("affinity", result.affinity);
+        add_number("iterations", result.iterations);
+        add_number("iterations_per_second", result.iterations_per_second);
+        add_number("time_ns", result.time_ns);
+        add_number("raw_time_ns", result.raw_time_ns);
+        add_number("overhead_ns", result.overhead_ns);
+        add_number("pauses_per_iteration", result.pauses_per_iteration);
+        add_number("allocations_per_iteration", result.allocations_per_iteration);
+        add_number("allocated_bytes_per_iteration", result.allocated_bytes_per_iteration);
+        key("unreliable");
+        buffer_ += result.unreliable ? "true" : "false";
+        if (!result.error.empty()) {
+            add_string("error", result.error);
+        }
+        add_number("stddev_ns", result.stddev_ns);
+        add_number("min_ns", result.min_ns);
+        add_number("p50_ns", result.p50_ns);
+        add_number("p90_ns", result.p90_ns);
+        add_number("p99_ns", result.p99_ns);
+        add_number("p999_ns", result.p999_ns);
+        add_number("max_ns", result.max_ns);
+        for (const auto& [name, value] : result.perf_counters) {
+            add_number(name, value);
+        }
+        for (const auto& [name, counter] : result.counters) {
+            add_number(name, counter.value);
+        }
+        buffer_ += "\n    }";
+        detail::write_all(out_, buffer_);
+    }
+
+    void finalize() override
+    {
+        detail::write_all(out_, "\n  ]\n}\n");
+    }
+
+private:
+    void key(std::string_view name)
+    {
+        buffer_ += separator_;
+        buffer_ += "      ";
+        detail::append_json_string(buffer_, name);
+        buffer_ += ": ";
+        separator_ = ",\n";
+    }
+
+    void add_string(std::string_view name, std::string_view value)
+    {
+        key(name);
+        detail::append_json_string(buffer_, value);
+    }
+
+    template<typename Number>
+    void add_number(std::string_view name, Number value)
+    {
+        key(name);
+        if constexpr (std::is_floating_point_v<Number>) {
+            detail::append_json_number(buffer_, value);
+        } else {
+            detail::append_number(buffer_, value);
+        }
+    }
+
+    std::FILE* out_;
+    std::string buffer_;
+    const char* separator_ { "\n" };
+    bool first_run_ { true };
+};
+
+// One row per benchmark, preceded by the context as "# key: value" comment lines. Counters get a
+// column each, so rows are kept until finalize() has seen every counter name of the run.
+class CsvReporter : public Reporter {
+public:
+    explicit CsvReporter(std::FILE* out)
+        : out_(out)
+    {
+    }
+
+    void report_context(const RunContext& context) override
+    {
+        std::string buffer;
+        for (const auto& [key, value] : context_entries(context)) {
+            buffer += "# ";
+            buffer += key;
+            buffer += ": ";
+            buffer += value;
+            buffer += '\n';
+        }
+        detail::write_all(out_, buffer);
+        rows_.clear();
+        counter_names_.clear();
+    }
+
+    void report_run(const BenchmarkResult& result) override
+    {
+        Row row;
+        detail::append_csv_field(row.fields, result.name);
+        for (const double value : {
+                 static_cast<double>(result.threads),
+                 static_cast<double>(result.iterations),
+                 result.time_ns,
+                 result.raw_time_ns,
+                 result.overhead_ns,
+                 result.pauses_per_iteration,
+                 result.allocations_per_iteration,
+                 result.allocated_bytes_per_iteration,
+                 result.stddev_ns,
+                 result.min_ns,
+                 result.p50_ns,
+                 result.p90_ns,
+                 result.p99_ns,
+                 result.p999_ns,
+                 result.max_ns,
+                 result.iterations_per_second,
+             }) {
+            row.fields += ',';
+            detail::append_number(row.fields, value);
+        }
+        row.fields += result.unreliable ? ",true," : ",false,";
+        detail::append_number(row.fields, result.repetition);
+        row.fields += ',';
+        detail::append_csv_field(row.fields, result.aggregate);
+        row.fields += ',';
+        detail::append_csv_field(row.fields, result.error);
+        const auto add_counter = [&](const std::string& name, double value) {
+            if (std::ranges::find(counter_names_, name) == counter_names_.end()) {
+                counter_names_.push_back(name);
+            }
+            row.counters.emplace_back(name, value);
+        };
+        for (const auto& [name, value] : result.perf_counters) {
+            add_counter(name, value);
+        }
+        for (const auto& [name, counter] : result.counters) {
+            add_counter(name, counter.value);
+        }
+        rows_.push_back(std::move(row));
+    }
+
+    void finalize() override
+    {
+        std::string buffer = "name,threads,iterations,time_ns,raw_time_ns,overhead_ns,"
+                             "pauses_per_iteration,allocations_per_iteration,"
+                             "allocated_bytes_per_iteration,stddev_ns,min_ns,p50_ns,p90_ns,p99_ns,"
+                             "p999_ns,max_ns,iterations_per_second,unreliable,repetition,aggregate,"
+                             "error";
+        for (const auto& name : counter_names_) {
+            buffer += ',';
+            detail::append_csv_field(buffer, name);
+        }
+        buffer += '\n';
+        for (const auto& row : rows_) {
+            buffer += row.fields;
+            for (const auto& name : counter_names_) {
+                buffer += ',';
+                const auto it = std::ranges::find(
+                    row.counters,
+                    name,
+                    &std::pair<std::string, double>::first);
+                if (it != row.counters.end()) {
+                    detail::append_number(buffer, it->second);
+                }
+            }
+            buffer += '\n';
+        }
+        detail::write_all(out_, buffer);
+        rows_.clear();
+    }
+
+private:
+    struct Row {
+        std::string fields;
+        std::vector<std::pair<std::string, double>> counters;
+    };
+
+    std::FILE* out_;
+    std::vector<Row> rows_;
+    std::vector<std::string> counter_names_;
+};
+
+// Layout of the files BinaryReporter writes, in the byte order of the machine that wrote them. The
+// file header is followed by records, each a BinaryRecordHeader then a payload padded to 8 bytes,
+// so every field, and the Sample arrays in particular, stay aligned in a mapping of the file.
+namespace detail {
+
+constexpr std::array<char, 8> kBinaryMagic { 'u', 's', 'c', 'o', 'p', 'e', '\0', 'b' };
+constexpr uint32_t kBinaryVersion = 3;
+constexpr uint32_t kBinaryByteOrderMark = 0x01020304;
+constexpr size_t kBinaryAlignment = 8;
+
+struct BinaryFileHeader {
+    std::array<char, 8> magic;
+    uint32_t version;
+    uint32_t byte_order_mark;
+};
+
+enum class BinaryRecordType : uint32_t {
+    // Pairs of key and value strings, see context_entries().
+    Context = 1,
+    Result = 2,
+};
+
+enum BinaryRecordFlags : uint32_t {
+    kBinaryZstd = 1U << 0,
+};
+
+struct BinaryRecordHeader {
+    BinaryRecordType type;
+    uint32_t flags;
+    // Of the payload as stored, without its padding.
+    uint64_t size;
+    uint64_t uncompressed_size;
+};
+
+// Fixed part of a Result payload. It is followed by the name, the affinity, the arguments, the
+// perf counters, the counters, the histogram buckets and the samples, each padded to 8 bytes.
+struct BinaryResultHeader {
+    uint32_t name_size;
+    uint32_t affinity_size;
+    uint32_t argument_count;
+    uint32_t perf_counter_count;
+    uint32_t counter_count;
+    int32_t threads;
+    uint32_t error_size;
+    uint32_t complexity;
+    uint64_t histogram_bucket_count;
+    uint64_t sample_count;
+    int64_t iterations;
+    uint32_t unreliable;
+    int32_t repetition;
+    double iterations_per_second;
+    double raw_time_ns;
+    double time_ns;
+    double overhead_ns;
+    double pauses_per_iteration;
+    double stddev_ns;
+    double min_ns;
+    double p50_ns;
+    double p90_ns;
+    double p99_ns;
+    double p999_ns;
+    double max_ns;
+    double allocations_per_iteration;
+    double allocated_bytes_per_iteration;
+    int64_t complexity_n;
+    Outliers outliers;
+};
+
+// A perf or user counter, followed by its name. flags holds the Counter flags and, shifted by
+// 16, its OneK.
+struct BinaryCounter {
+    uint32_t name_size;
+    uint32_t flags;
+    double value;
+};
+
+static_assert(sizeof(Sample) == 16 && alignof(Sample) <= kBinaryAlignment);
+static_assert(sizeof(BinaryRecordHeader) % kBinaryAlignment == 0);
+static_assert(sizeof(BinaryResultHeader) % kBinaryAlignment == 0);
+
+constexpr size_t padded_size(size_t size)
+{
+    return (size + kBinaryAlignment - 1) / kBinaryAlignment * kBinaryAlignment;
+}
+
+class BinaryWriter {
+public:
+    void clear()
+    {
+        bytes_.clear();
+    }
+
+    template<typename T>
+        requires std::is_trivially_copyable_v<T>
+    void put(const T& value)
+    {
+        put_bytes(&value, sizeof(T));
+    }
+
+    void put_bytes(const void* data, size_t size)
+    {
+        const auto* first = static_cast<const std::byte*>(data);
+        bytes_.insert(bytes_.end(), first, first + size);
+    }
+
+    // Strings and arrays each end padded, keeping whatever follows them aligned.
+    void put_padded(const void* data, size_t size)
+    {
+        put_bytes(data, size);
+        bytes_.resize(padded_size(bytes_.size()));
+    }
+
+    [[nodiscard]] std::span<const std::byte> bytes() const
+    {
+        return bytes_;
+    }
+
+private:
+    std::vector<std::byte> bytes_;
+};
+
+// Bounds-checked reads from a payload, failing for good on the first one out of range.
+class BinaryCursor {
+public:
+    explicit BinaryCursor(std::span<const std::byte> bytes)
+        : bytes_(bytes)
+    {
+    }
+
+    template<typename T>
+        requires std::is_trivially_copyable_v<T>
+    bool get(T& value)
+    {
+        const std::span<const std::byte> bytes = take(sizeof(T), false);
+        if (bytes.size() != sizeof(T)) {
+            return false;
+        }
+        std::memcpy(&value, bytes.data(), sizeof(T));
+        return true;
+    }
+
+    std::span<const std::byte> take(size_t size, bool padded = true)
+    {
+        const size_t stored = padded ? padded_size(size) : size;
+        if (!ok_ || stored > bytes_.size() - offset_) {
+            ok_ = false;
+            return {};
+        }
+        const std::span<const std::byte> bytes = bytes_.subspan(offset_, size);
+        offset_ += stored;
+        return bytes;
+    }
+
+    template<typename T>
+    std::span<const std::byte> take_array(uint64_t count)
+    {
+        if (!ok_ || count > remaining() / sizeof(T)) {
+            ok_ = false;
+            return {};
+        }
+        return take(static_cast<size_t>(count) * sizeof(T));
+    }
+
+    template<typename T>
+        requires std::is_trivially_copyable_v<T>
+    std::vector<T> get_array(uint64_t count)
+    {
+        const std::span<const std::byte> bytes = take_array<T>(count);
+        std::vector<T> values(bytes.size() / sizeof(T));
+        if (!bytes.empty()) {
+            std::memcpy(values.data(), bytes.data(), bytes.size());
+        }
+        return values;
+    }
+
+    std::string get_string(size_t size)
+    {
+        const std::span<const std::byte> bytes = take(size);
+        return std::string(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+    }
+
+    [[nodiscard]] bool ok() const
+    {
+        return ok_;
+    }
+
+    [[nodiscard]] size_t remaining() const
+    {
+        return ok_ ? bytes_.size() - offset_ : 0;
+    }
+
+private:
+    std::span<const std::byte> bytes_;
+    size_t offset_ { 0 };
+    bool ok_ { true };
+};
+
+// Writes a Result payload, see BinaryResultHeader.
+inline void put_result(BinaryWriter& payload, const BenchmarkResult& result)
+{
+    payload.put(BinaryResultHeader {
+        .name_size = static_cast<uint32_t>(result.name.size()),
+        .affinity_size = static_cast<uint32_t>(result.affinity.size()),
+        .argument_count = static_cast<uint32_t>(result.arguments.size()),
+        .perf_counter_count = static_cast<uint32_t>(result.perf_counters.size()),
+        .counter_count = static_cast<uint32_t>(result.counters.size()),
+        .threads = result.threads,
+        .error_size = static_cast<uint32_t>(result.error.size()),
+        .complexity = static_cast<uint32_t>(result.complexity),
+        .histogram_bucket_count = result.histogram.size(),
+        .sample_count = result.samples.size(),
+        .iterations = result.iterations,
+        .unreliable = result.unreliable ? 1U : 0U,
+        .repetition = result.repetition,
+        .iterations_per_second = result.iterations_per_second,
+        .raw_time_ns = result.raw_time_ns,
+        .time_ns = result.time_ns,
+        .overhead_ns = result.overhead_ns,
+        .pauses_per_iteration = result.pauses_per_iteration,
+        .stddev_ns = result.stddev_ns,
+        .min_ns = result.min_ns,
+        .p50_ns = result.p50_ns,
+        .p90_ns = result.p90_ns,
+        .p99_ns = result.p99_ns,
+        .p999_ns = result.p999_ns,
+        .max_ns = result.max_ns,
+        .allocations_per_iteration = result.allocations_per_iteration,
+        .allocated_bytes_per_iteration = result.allocated_bytes_per_iteration,
+        .complexity_n = result.complexity_n,
+        .outliers = result.outliers,
+    });
+    payload.put_padded(result.name.data(), result.name.size());
+    payload.put_padded(result.affinity.data(), result.affinity.size());
+    payload.put_padded(result.error.data(), result.error.size());
+    payload.put_padded(result.arguments.data(), result.arguments.size() * sizeof(Argument));
+    for (const auto& [name, value] : result.perf_counters) {
+        payload.put(BinaryCounter { static_cast<uint32_t>(name.size()), 0, value });
+        payload.put_padded(name.data(), name.size());
+    }
+    for (const auto& [name, counter] : result.counters) {
+        const uint32_t flags = static_cast<uint32_t>(counter.flags)
+            | (static_cast<uint32_t>(counter.one_k) << 16);
+        payload.put(BinaryCounter { static_cast<uint32_t>(name.size()), flags, counter.value });
+        payload.put_padded(name.data(), name.size());
+    }
+    payload.put_padded(result.histogram.data(), result.histogram.size() * sizeof(HistogramBucket));
+    payload.put_padded(result.samples.data(), result.samples.size() * sizeof(Sample));
+}
+
+// Reads a Result payload into every field of result but samples, which are left in the payload and
+// viewed by the span instead.
+inline bool
+get_result(BinaryCursor& fields, BenchmarkResult& result, std::span<const Sample>& samples)
+{
+    BinaryResultHeader header {};
+    if (!fields.get(header)) {
+        return false;
+    }
+    result.name = fields.get_string(header.name_size);
+    result.affinity = fields.get_string(header.affinity_size);
+    result.error = fields.get_string(header.error_size);
+    result.arguments = fields.get_array<Argument>(header.argument_count);
+    for (uint32_t index = 0; index < header.perf_counter_count && fields.ok(); ++index) {
+        BinaryCounter counter {};
+        fields.get(counter);
+        std::string name = fields.get_string(counter.name_size);
+        result.perf_counters.emplace_back(std::move(name), counter.value);
+    }
+    for (uint32_t index = 0; index < header.counter_count && fields.ok(); ++index) {
+        BinaryCounter counter {};
+        fields.get(counter);
+        std::string name = fields.get_string(counter.name_size);
+        result.counters.emplace_back(
+            std::move(name),
+            Counter {
+                .value = counter.value,
+                .flags = static_cast<Counter::Flags>(counter.flags & 0xffffU),
+                .one_k = static_cast<Counter::OneK>(counter.flags >> 16),
+            });
+    }
+    result.histogram = fields.get_array<HistogramBucket>(header.histogram_bucket_count);
+    const std::span<const std::byte> sample_bytes
+        = fields.take_array<Sample>(header.sample_count);
+    if (!fields.ok()) {
+        return false;
+    }
+    samples = std::span<const Sample>(
+        reinterpret_cast<const Sample*>(sample_bytes.data()),
+        static_cast<size_t>(header.sample_count));
+    result.threads = header.threads;
+    result.iterations_per_second = header.iterations_per_second;
+    result.iterations = header.iterations;
+    result.raw_time_ns = header.raw_time_ns;
+    result.time_ns = header.time_ns;
+    result.overhead_ns = header.overhead_ns;
+    result.pauses_per_iteration = header.pauses_per_iteration;
+    result.unreliable = header.unreliable != 0;
+    result.repetition = header.repetition;
+    result.stddev_ns = header.stddev_ns;
+    result.min_ns = header.min_ns;
+    result.p50_ns = header.p50_ns;
+    result.p90_ns = header.p90_ns;
+    result.p99_ns = header.p99_ns;
+    result.p999_ns = header.p999_ns;
+    result.max_ns = header.max_ns;
+    result.allocations_per_iteration = header.allocations_per_iteration;
+    result.allocated_bytes_per_iteration = header.allocated_bytes_per_iteration;
+    result.complexity_n = header.complexity_n;
+    result.complexity = static_cast<Complexity>(header.complexity);
+    result.outliers = header.outliers;
+    return true;
+}
+
+// Read-only contents of a file, memory-mapped where possible.
+class MappedFile {
+public:
+    static std::optional<MappedFile> open(const std::string& path)
+    {
+        MappedFile file;
+#if defined(__linux__)
+        const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return std::nullopt;
+        }
+        struct stat status {};
+        if (fstat(fd, &status) == 0 && status.st_size > 0) {
+            const auto size = static_cast<size_t>(status.st_size);
+            void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data != MAP_FAILED) {
+                file.mapping_ = data;
+                file.bytes_ = { static_cast<const std::byte*>(data), size };
+            }
+        }
+        ::close(fd);
+        if (file.mapping_ != nullptr) {
+            return file;
+        }
+#endif
+        std::FILE* stream = std::fopen(path.c_str(), "rb");
+        if (stream == nullptr) {
+            return std::nullopt;
+        }
+        std::array<std::byte, 1 << 16> chunk {};
+        size_t read = 0;
+        while ((read = std::fread(chunk.data(), 1, chunk.size(), stream)) > 0) {
+            file.buffer_.insert(file.buffer_.end(), chunk.begin(), chunk.begin() + read);
+        }
+        std::fclose(stream);
+        file.bytes_ = file.buffer_;
+        return file;
+    }
+
+    MappedFile(MappedFile&& other) noexcept
+        : mapping_(std::exchange(other.mapping_, nullptr))
+        , bytes_(std::exchange(other.bytes_, {}))
+        , buffer_(std::move(other.buffer_))
+    {
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile& operator=(MappedFile&&) = delete;
+
+    ~MappedFile()
+    {
+#if defined(__linux__)
+        if (mapping_ != nullptr) {
+            munmap(mapping_, bytes_.size());
+        }
+#endif
+    }
+
+    [[nodiscard]] std::span<const std::byte> bytes() const
+    {
+        return bytes_;
+    }
+
+private:
+    MappedFile() = default;
+
+    void* mapping_ { nullptr };
+    std::span<const std::byte> bytes_;
+    std::vector<std::byte> buffer_;
+};
+
+} // namespace detail
+
+// Length-prefixed records of the context and of every result, including the sparse histogram and,
+// with SampleStorage::Raw, every sample. Records are zstd-compressed when compress is set and the
+// header is built with USCOPE_USE_ZSTD and zstd available; read them back with BinaryResultFile.
+class BinaryReporter : public Reporter {
+public:
+    explicit BinaryReporter(std::FILE* out, bool compress = false)
+        : out_(out)
+        , compress_(compress && USCOPE_HAS_ZSTD)
+    {
+    }
+
+    void report_context(const RunContext& context) override
+    {
+        if (!file_header_written_) {
+            const detail::BinaryFileHeader header {
+                .magic = detail::kBinaryMagic,
+                .version = detail::kBinaryVersion,
+                .byte_order_mark = detail::kBinaryByteOrderMark,
+            };
+            std::fwrite(&header, sizeof(header), 1, out_);
+            file_header_written_ = true;
+        }
+        payload_.clear();
+        const auto entries = context_entries(context);
+        payload_.put(static_cast<uint64_t>(entries.size()));
+        for (const auto& [key, value] : entries) {
+            payload_.put(static_cast<uint32_t>(key.size()));
+            payload_.put(static_cast<uint32_t>(value.size()));
+            payload_.put_padded(key.data(), key.size());
+            payload_.put_padded(value.data(), value.size());
+        }
+        write_record(detail::BinaryRecordType::Context);
+    }
+
+    // Aggregates are left out, they are recomputed from the repetitions when needed.
+    void report_run(const BenchmarkResult& result) override
+    {
+        if (!result.aggregate.empty()) {
+            return;
+        }
+        payload_.clear();
+        detail::put_result(payload_, result);
+        write_record(detail::BinaryRecordType::Result);
+    }
+
+private:
+    void write_record(detail::BinaryRecordType type)
+    {
+        std::span<const std::byte> stored = payload_.bytes();
+        detail::BinaryRecordHeader header {
+            .type = type,
+            .flags = 0,
+            .size = stored.size(),
+            .uncompressed_size = stored.size(),
+        };
+#if USCOPE_HAS_ZSTD
+        if (compress_) {
+            compressed_.resize(ZSTD_compressBound(stored.size()));
+            const size_t size = ZSTD_compress(
+                compressed_.data(),
+                compressed_.size(),
+                stored.data(),
+                stored.size(),
+                kCompressionLevel);
+            if (ZSTD_isError(size) == 0) {
+                header.flags |= detail::kBinaryZstd;
+                header.size = size;
+                stored = std::span<const std::byte>(compressed_.data(), size);
+            }
+        }
+#endif
+        static constexpr std::array<std::byte, detail::kBinaryAlignment> kPadding {};
+        std::fwrite(&header, sizeof(header), 1, out_);
+        std::fwrite(stored.data(), 1, stored.size(), out_);
+        std::fwrite(kPadding.data(), 1, detail::padded_size(stored.size()) - stored.size(), out_);
+        std::fflush(out_);
+    }
+
+#if USCOPE_HAS_ZSTD
+    static constexpr int kCompressionLevel = 3;
+    std::vector<std::byte> compressed_;
+#endif
+    std::FILE* out_;
+    bool compress_;
+    bool file_header_written_ { false };
+    detail::BinaryWriter payload_;
+};
+
+// Forwards everything to several reporters, in order, for instance the console and a file.
+class TeeReporter : public Reporter {
+public:
+    explicit TeeReporter(std::vector<Reporter*> reporters)
+        : reporters_(std::move(reporters))
+    {
+    }
+
+    void report_context(const RunContext& context) override
+    {
+        for (Reporter* reporter : reporters_) {
+            reporter->report_context(context);
+        }
+    }
+
+    void report_run(const BenchmarkResult& result) override
+    {
+        for (Reporter* reporter : reporters_) {
+            reporter->report_run(result);
+        }
+    }
+
+    void finalize() override
+    {
+        for (Reporter* reporter : reporters_) {
+            reporter->finalize();
+        }
+    }
+
+private:
+    std::vector<Reporter*> reporters_;
+};
+
+// Contents of a file written by BinaryReporter. The file stays mapped for the lifetime of the
+// object and the samples of uncompressed records are viewed in place; compressed records are
+// decompressed once, when the file is opened.
+class BinaryResultFile {
+public:
+    struct Run {
+        // Every field but samples, which are viewed by the span below instead.
+        BenchmarkResult result;
+        std::span<const Sample> samples;
+    };
+
+    // Empty when the file cannot be read or is not a valid uscope binary result file.
+    static std::optional<BinaryResultFile> open(const std::string& path)
+    {
+        std::optional<detail::MappedFile> mapped = detail::MappedFile::open(path);
+        if (!mapped) {
+            return std::nullopt;
+        }
+        BinaryResultFile file(std::move(*mapped));
+        if (!file.parse()) {
+            return std::nullopt;
+        }
+        return file;
+    }
+
+    // Key and value pairs of every context record, in file order.
+    [[nodiscard]] const std::vector<std::pair<std::string, std::string>>& context() const
+    {
+        return context_;
+    }
+
+    [[nodiscard]] const std::vector<Run>& runs() const
+    {
+        return runs_;
+    }
+
+private:
+    explicit BinaryResultFile(detail::MappedFile file)
+        : file_(std::move(file))
+    {
+    }
+
+    bool parse()
+    {
+        detail::BinaryCursor cursor(file_.bytes());
+        detail::BinaryFileHeader header {};
+        if (!cursor.get(header) || header.magic != detail::kBinaryMagic
+            || header.version != detail::kBinaryVersion
+            || header.byte_order_mark != detail::kBinaryByteOrderMark) {
+            return false;
+        }
+        while (cursor.remaining() > 0) {
+            detail::BinaryRecordHeader record {};
+            if (!cursor.get(record)) {
+                return false;
+            }
+            const std::span<const std::byte> stored = cursor.take(record.size);
+            if (!cursor.ok()) {
+                return false;
+            }
+            const std::optional<std::span<const std::byte>> payload = decode(record, stored);
+            if (!payload) {
+                return false;
+            }
+            detail::BinaryCursor fields(*payload);
+            switch (record.type) {
+            case detail::BinaryRecordType::Context:
+                if (!parse_context(fields)) {
+                    return false;
+                }
+                break;
+            case detail::BinaryRecordType::Result:
+                if (!parse_result(fields)) {
+                    return false;
+                }
+                break;
+            default:
+                // Record types of later versions are skipped.
+                break;
+            }
+        }
+        return true;
+    }
+
+    std::optional<std::span<const std::byte>>
+    decode(const detail::BinaryRecordHeader& record, std::span<const std::byte> stored)
+    {
+        if ((record.flags & detail::kBinaryZstd) == 0) {
+            return stored;
+        }
+#if USCOPE_HAS_ZSTD
+        auto& buffer = decompressed_.emplace_back(
+            std::make_unique_for_overwrite<std::byte[]>(record.uncompressed_size));
+        const size_t size = ZSTD_decompress(
+            buffer.get(),
+            record.uncompressed_size,
+            stored.data(),
+            stored.size());
+        if (ZSTD_isError(size) != 0 || size != record.uncompressed_size) {
+            return std::nullopt;
+        }
+        return std::span<const std::byte>(buffer.get(), size);
+#else
+        return std::nullopt;
+#endif
+    }
+
+    bool parse_context(detail::BinaryCursor& fields)
+    {
+        uint64_t count = 0;
+        if (!fields.get(count)) {
+            return false;
+        }
+        for (uint64_t index = 0; index < count; ++index) {
+            uint32_t key_size = 0;
+            uint32_t value_size = 0;
+            if (!fields.get(key_size) || !fields.get(value_size)) {
+                return false;
+            }
+            std::string key = fields.get_string(key_size);
+            std::string value = fields.get_string(value_size);
+            if (!fields.ok()) {
+                return false;
+            }
+            context_.emplace_back(std::move(key), std::move(value));
+        }
+        return true;
+    }
+
+    bool parse_result(detail::BinaryCursor& fields)
+    {
+        Run run {};
+        if (!detail::get_result(fields, run.result, run.samples)) {
+            return false;
+        }
+        runs_.push_back(std::move(run));
+        return true;
+    }
+
+    detail::MappedFile file_;
+    std::vector<std::unique_ptr<std::byte[]>> decompressed_;
+    std::vector<std::pair<std::string, std::string>> context_;
+    std::vector<Run> runs_;
+};
+
+namespace detail {
+
+// CPUs for the workers of a parallel suite, keeping the first CPU of each set of SMT siblings.
+inline std::vector<int> suite_cpus(const std::vector<int>& requested)
+{
+    std::vector<int> candidates = requested;
+    const std::vector<int> allowed = ScopedPlacement::effective_cpus();
+    if (candidates.empty()) {
+        const std::vector<int> isolated
+            = parse_cpu_list(read_text_line("/sys/devices/system/cpu/isolated"));
+        for (const int cpu : isolated) {
+            if (std::ranges::find(allowed, cpu) != allowed.end()) {
+                candidates.push_back(cpu);
+            }
+        }
+    }
+    if (candidates.empty()) {
+        candidates = allowed;
+    }
+    std::vector<int> cpus;
+    std::vector<int> siblings_taken;
+    for (const int cpu : candidates) {
+        const std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu)
+            + "/topology/thread_siblings_list";
+        const std::vector<int> siblings = parse_cpu_list(read_text_line(path.c_str()));
+        if (std::ranges::find(siblings_taken, cpu) != siblings_taken.end()) {
+            continue;
+        }
+        siblings_taken.insert(siblings_taken.end(), siblings.begin(), siblings.end());
+        cpus.push_back(cpu);
+    }
+    if (cpus.empty()) {
+        cpus.push_back(0);
+    }
+    return cpus;
+}
+
+} // namespace detail
+
+#if defined(__linux__)
+namespace detail {
+
+// Anonymous mapping shared with the forked children of Config::isolate, reserved once and backed
+// only by the pages their results touch. It starts with the size of the results that follow, or
+// kOverflow when they did not fit.
+class SharedResultBuffer {
+public:
+    static constexpr size_t kCapacity = size_t { 1 } << 30;
+    static constexpr uint64_t kOverflow = std::numeric_limits<uint64_t>::max();
+
+    SharedResultBuffer() = default;
+    SharedResultBuffer(const SharedResultBuffer&) = delete;
+    SharedResultBuffer& operator=(const SharedResultBuffer&) = delete;
+
+    ~SharedResultBuffer()
+    {
+        if (data_ != nullptr) {
+            munmap(data_, kCapacity);
+        }
+    }
+
+    // Empty when the mapping fails.
+    std::span<std::byte> bytes()
+    {
+        if (data_ == nullptr) {
+            void* data = mmap(
+                nullptr,
+                kCapacity,
+                PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_ANONYMOUS | MAP_NORESERVE,
+                -1,
+                0);
+            if (data == MAP_FAILED) {
+                return {};
+            }
+            data_ = static_cast<std::byte*>(data);
+        }
+        return { data_, kCapacity };
+    }
+
+private:
+    std::byte* data_ { nullptr };
+};
+
+// Exit status of the child, or nullopt once it was killed for outliving the timeout. The wait
+// blocks on a pidfd where the kernel has them, so the run ends as soon as the child does.
+inline std::optional<int> wait_for_child(pid_t child, std::chrono::nanoseconds timeout)
+{
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+#if defined(SYS_pidfd_open)
+    const auto pidfd = static_cast<int>(syscall(SYS_pidfd_open, child, 0));
+#else
+    const int pidfd = -1;
+#endif
+    auto backoff = std::chrono::microseconds(100);
+    std::optional<int> result;
+    while (true) {
+        int status = 0;
+        const pid_t waited = waitpid(child, &status, WNOHANG);
+        if (waited == child) {
+            result = status;
+            break;
+        }
+        if (waited < 0 && errno != EINTR) {
+            // Reaped already, with SIGCHLD ignored: only the results say how it went.
+            result = 0;
+            break;
+        }
+        const auto now = std::chrono::steady_clock::now();
+        if (now >= deadline) {
+            kill(child, SIGKILL);
+            while (waitpid(child, &status, 0) < 0 && errno == EINTR) { }
+            break;
+        }
+        const auto remaining = std::chrono::ceil<std::chrono::milliseconds>(deadline - now);
+        if (pidfd >= 0) {
+            pollfd fd { .fd = pidfd, .events = POLLIN, .revents = 0 };
+            poll(&fd, 1, static_cast<int>(std::min<int64_t>(remaining.count(), 1'000'000)));
+        } else {
+            std::this_thread::sleep_for(std::min<std::chrono::nanoseconds>(backoff, remaining));
+            backoff = std::min(backoff * 2, std::chrono::microseconds(10'000));
+        }
+    }
+    if (pidfd >= 0) {
+        close(pidfd);
+    }
+    return result;
+}
+
+// Function names of code addresses, from the ELF symbol tables of the objects loaded in the
+// process, each read on first use, or else from dladdr().
+class Symbolizer {
+public:
+    std::string name(uint64_t address)
+    {
+        if (modules_.empty()) {
+            dl_iterate_phdr(&add_module, this);
+        }
+        const auto cached = names_.find(address);
+        if (cached != names_.end()) {
+            return cached->second;
+        }
+        std::string name = lookup(address);
+        names_.emplace(address, name);
+        return name;
+    }
+
+private:
+    struct Symbol {
+        uint64_t value;
+        uint64_t size;
+        std::string name;
+    };
+
+    struct Module {
+        std::string path;
+        uint64_t bias;
+        uint64_t begin;
+        uint64_t end;
+        bool loaded;
+        std::vector<Symbol> symbols;
+    };
+
+    static int add_module(dl_phdr_info* info, size_t /*size*/, void* data)
+    {
+        Module module {
+            .path = (info->dlpi_name[0] != '\0') ? info->dlpi_name : "/proc/self/exe",
+            .bias = info->dlpi_addr,
+            .begin = std::numeric_limits<uint64_t>::max(),
+            .end = 0,
+            .loaded = false,
+            .symbols = {},
+        };
+        for (ElfW(Half) index = 0; index < info->dlpi_phnum; ++index) {
+            const ElfW(Phdr)& segment = info->dlpi_phdr[index];
+            if (segment.p_type == PT_LOAD && (segment.p_flags & PF_X) != 0) {
+                module.begin = std::min<uint64_t>(module.begin, module.bias + segment.p_vaddr);
+                module.end = std::max<uint64_t>(
+                    module.end,
+                    module.bias + segment.p_vaddr + segment.p_memsz);
+            }
+        }
+        if (module.begin < module.end) {
+            static_cast<Symbolizer*>(data)->modules_.push_back(std::move(module));
+        }
+        return 0;
+    }
+
+    std::string lookup(uint64_t address)
+    {
+        for (Module& module : modules_) {
+            if (address < module.begin || address >= module.end) {
+                continue;
+            }
+            if (!module.loaded) {
+                load_symbols(module);
+            }
+            const uint64_t offset = address - module.bias;
+            auto it = std::ranges::upper_bound(module.symbols, offset, {}, &Symbol::value);
+            if (it != module.symbols.begin()) {
+                --it;
+                if (it->size == 0 || offset < it->value + it->size) {
+                    return demangle(it->name.c_str());
+                }
+            }
+            Dl_info info {};
+            if (dladdr(reinterpret_cast<void*>(address), &info) != 0
+                && info.dli_sname != nullptr) {
+                return demangle(info.dli_sname);
+            }
+            const size_t slash = module.path.rfind('/');
+            return "[" + module.path.substr((slash == std::string::npos) ? 0 : slash + 1) + "]";
+        }
+        std::array<char, 24> text {};
+        std::snprintf(text.data(), text.size(), "0x%llx", static_cast<unsigned long long>(address));
+        return text.data();
+    }
+
+    // Functions of both the static and the dynamic symbol tables, sorted by address.
+    static void load_symbols(Module& module)
+    {
+        module.loaded = true;
+        const std::optional<MappedFile> file = MappedFile::open(module.path);
+        if (!file) {
+            return;
+        }
+        const std::span<const std::byte> bytes = file->bytes();
+        const auto read = [&]<typename T>(uint64_t offset, T& value) {
+            if (offset > bytes.size() || sizeof(T) > bytes.size() - offset) {
+                return false;
+            }
+            std::memcpy(&value, bytes.data() + offset, sizeof(T));
+            return true;
+        };
+        ElfW(Ehdr) header {};
+        if (!read(0, header) || std::memcmp(header.e_ident, ELFMAG, SELFMAG) != 0) {
+            return;
+        }
+        for (ElfW(Half) index = 0; index < header.e_shnum; ++index) {
+            ElfW(Shdr) table {};
+            ElfW(Shdr) strings {};
+            if (!read(header.e_shoff + index * sizeof(ElfW(Shdr)), table)
+                || (table.sh_type != SHT_SYMTAB && table.sh_type != SHT_DYNSYM)
+                || !read(header.e_shoff + table.sh_link * sizeof(ElfW(Shdr)), strings)
+                || strings.sh_offset > bytes.size()) {
+                continue;
+            }
+            const auto* names = reinterpret_cast<const char*>(bytes.data() + strings.sh_offset);
+            const size_t names_size
+                = std::min<uint64_t>(strings.sh_size, bytes.size() - strings.sh_offset);
+            for (uint64_t entry = 0; entry < table.sh_size / sizeof(ElfW(Sym)); ++entry) {
+                ElfW(Sym) symbol {};
+                if (!read(table.sh_offset + entry * sizeof(ElfW(Sym)), symbol)) {
+                    break;
+                }
+                if ((symbol.st_info & 0xf) != STT_FUNC || symbol.st_value == 0
+                    || symbol.st_shndx == SHN_UNDEF || symbol.st_name >= names_size) {
+                    continue;
+                }
+                module.symbols.push_back(Symbol {
+                    .value = symbol.st_value,
+                    .size = symbol.st_size,
+                    .name = std::string(
+                        names + symbol.st_name,
+                        strnlen(names + symbol.st_name, names_size - symbol.st_name)),
+                });
+            }
+        }
+        std::ranges::sort(module.symbols, {}, &Symbol::value);
+    }
+
+    static std::string demangle(const char* name)
+    {
+#if USCOPE_HAS_CXXABI
+        int status = 0;
+        char* demangled = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+        if (status == 0 && demangled != nullptr) {
+            std::string result(demangled);
+            std::free(demangled);
+            return result;
+        }
+#endif
+        return name;
+    }
+
+    std::vector<Module> modules_;
+    std::map<uint64_t, std::string> names_;
+};
+
+} // namespace detail
+#endif
+
+class BenchmarkRunner {
+public:
+    // Results go to reporter, which has to outlive the runner, or to the console when it is null.
+    explicit BenchmarkRunner(const Config& config, Reporter* reporter = nullptr)
+        : config_(config)
+        , filter_(
+              config.filter.empty() ? std::nullopt
+                                    : std::optional<std::regex>(std::in_place, config.filter))
+        , reporter_(reporter)
+    {
+    }
+
+    // Convenience overload: the runner owns the benchmark, which costs one allocation.
+    template<BenchmarkFunction Fn>
+    void add_benchmark(std::string_view name, Fn&& function)
+    {
+        benchmarks_.push_back(owned_benchmarks_.emplace_front(name, std::forward<Fn>(function)));
+    }
+
+    // Same for an async benchmark, run on an Executor.
+    template<AsyncBenchmarkFunction Fn>
+    void add_benchmark(std::string_view name, Fn&& function)
+    {
+        add_benchmark(name, [function = std::forward<Fn>(function)](BenchmarkState& state) mutable {
+            Executor executor;
+            executor.run(std::invoke(function, state));
+        });
+    }
+
+    // Same for a function compiled for the settings of options, see StaticState.
+    template<auto Function, StaticConfig Options = StaticConfig {}>
+        requires StaticBenchmarkFunction<decltype(Function), Options>
+    void add_benchmark(std::string_view name)
+    {
+        benchmarks_.push_back(
+            owned_benchmarks_.emplace_front(name, &detail::run_static<Function, Options>)
+                .static_config(Options));
+    }
+
+    // The benchmark is only linked, without allocating, and has to outlive the runner.
+    void add_benchmark(Benchmark& benchmark)
+    {
+        benchmarks_.push_back(benchmark);
+    }
+
+    // Links every entry of a table, typically a constinit array of benchmarks with static storage.
+    void add_benchmarks(std::span<Benchmark> benchmarks)
+    {
+        for (auto& benchmark : benchmarks) {
+            benchmarks_.push_back(benchmark);
+        }
+    }
+
+    void run_all_benchmarks()
+    {
+        run_benchmarks(select_benchmarks(benchmarks_));
+    }
+
+    // Runs the benchmarks registered with USCOPE_BENCHMARK in every linked translation unit.
+    void run_registered_benchmarks()
+    {
+        run_benchmarks(select_benchmarks(BenchmarkRegistry::instance().benchmarks()));
+    }
+
+    // Names of the runs run_registered_benchmarks() would run, without running them.
+    [[nodiscard]] std::vector<std::string> registered_run_names() const
+    {
+        std::vector<std::string> names;
+        for_each_run(
+            select_benchmarks(BenchmarkRegistry::instance().benchmarks()),
+            [&](Benchmark&, std::span<const Argument>, std::string name, int) {
+                names.push_back(std::move(name));
+            });
+        return names;
+    }
+
+    [[nodiscard]] const std::vector<BenchmarkResult>& results() const
+    {
+        return results_;
+    }
+
+    // Whether the last run refused to start, see Config::strict_environment.
+    [[nodiscard]] bool refused() const
+    {
+        return refused_;
+    }
+
+private:
+    // The benchmarks with at least one run selected by the filter, see for_each_run().
+    [[nodiscard]] std::vector<Benchmark*> select_benchmarks(const BenchmarkList& benchmarks) const
+    {
+        std::vector<Benchmark*> selected;
+        for (auto& benchmark : benchmarks) {
+            Benchmark* const candidate = &benchmark;
+            bool any = !filter_ || std::regex_search(benchmark.family_name(), *filter_);
+            if (!any) {
+                for_each_run(
+                    std::span(&candidate, 1),
+                    [&](Benchmark&, std::span<const Argument>, std::string, int) { any = true; });
+            }
+            if (any) {
+                selected.push_back(candidate);
+            }
+        }
+        return selected;
+    }
+
+    Reporter& reporter()
+    {
+        return (reporter_ != nullptr) ? *reporter_ : console_reporter_;
+    }
+
+    // The settings of the runner with the static ones of the benchmark, if any, over them.
+    [[nodiscard]] Config benchmark_config(const Benchmark& benchmark) const
+    {
+        Config config = config_;
+        if (const std::optional<StaticConfig> options = benchmark.static_config()) {
+            if (options->iteration_count > 0) {
+                config.iteration_count = options->iteration_count;
+            }
+            config.batch_size = options->batch_size;
+            config.clock = options->clock;
+        }
+        return config;
+    }
+
+    [[nodiscard]] const std::vector<int>& thread_counts(const Benchmark& benchmark) const
+    {
+        return benchmark.thread_counts().empty() ? config_.threads : benchmark.thread_counts();
+    }
+
+    [[nodiscard]] static bool single_threaded(const std::vector<int>& thread_counts)
+    {
+        return thread_counts.empty() || (thread_counts.size() == 1 && thread_counts.front() == 1);
+    }
+
+    static constexpr std::string_view kThreadsSuffix = "/threads:";
+
+    // Calls visit(benchmark, arguments, name, thread_count) for every run of the benchmarks that
+    // the filter selects: all of them when it matches the family name, else those whose name it
+    // matches. Points of argument families are generated one at a time, nothing is built for a
+    // whole family.
+    template<typename Visit>
+    void for_each_run(std::span<Benchmark* const> benchmarks, Visit&& visit) const
+    {
+        for (Benchmark* benchmark : benchmarks) {
+            const bool whole = !filter_ || std::regex_search(benchmark->family_name(), *filter_);
+            const auto selected = [&](const std::string& name) {
+                return whole || std::regex_search(name, *filter_);
+            };
+            const std::vector<int>& counts = thread_counts(*benchmark);
+            for (size_t index = 0; index < benchmark->argument_count(); ++index) {
+                const std::vector<Argument> arguments = benchmark->arguments(index);
+                std::string name = benchmark->run_name(arguments);
+                if (single_threaded(counts)) {
+                    if (selected(name)) {
+                        visit(*benchmark, arguments, std::move(name), 1);
+                    }
+                    continue;
+                }
+                for (const int thread_count : counts) {
+                    std::string thread_name
+                        = name + std::string(kThreadsSuffix) + std::to_string(thread_count);
+                    if (selected(thread_name)) {
+                        visit(
+                            *benchmark,
+                            arguments,
+                            std::move(thread_name),
+                            std::max(thread_count, 1));
+                    }
+                }
+            }
+        }
+    }
+
+    void run_benchmarks(const std::vector<Benchmark*>& benchmarks)
+    {
+        static constexpr std::string_view kLongestAggregateSuffix = "_median";
+
+        const Environment environment = probe_environment();
+        const TimingOverhead overhead = detail::timing_overhead_ns(config_);
+        // Measured here, before any run, for the benchmarks with their own batch size or clock.
+        static_overheads_.clear();
+        for (Benchmark* benchmark : benchmarks) {
+            if (benchmark->static_config()) {
+                static_overheads_.emplace(
+                    benchmark,
+                    detail::timing_overhead_ns(benchmark_config(*benchmark)));
+            }
+        }
+        const int repetitions = std::max(config_.repetitions, 1);
+        // Rows are printed as runs end, so the widths come from the counts every run may reach:
+        // its fixed iteration count, or else the calibration limit, on each of its threads.
+        const auto iterations_per_thread = [&](const Benchmark& benchmark) {
+            const Iteration fixed = benchmark.static_config()
+                ? benchmark_config(benchmark).iteration_count
+                : config_.iteration_count;
+            return (fixed > 0) ? fixed : config_.max_iterations;
+        };
+        size_t name_width = 0;
+        size_t iterations_width = 0;
+        for_each_run(
+            benchmarks,
+            [&](Benchmark& benchmark,
+                std::span<const Argument> arguments,
+                std::string name,
+                int thread_count) {
+                iterations_width = std::max(
+                    iterations_width,
+                    count_digits(iterations_per_thread(benchmark) * thread_count));
+                name_width = std::max(
+                    name_width,
+                    name.size() + ((repetitions > 1) ? kLongestAggregateSuffix.size() : 0));
+                if (benchmark.complexity() != Complexity::None) {
+                    name_width = std::max(
+                        name_width,
+                        complexity_name(benchmark, arguments, name, kBigOSuffix).size());
+                }
+            });
+        Reporter& output = reporter();
+        output.report_context(
+            RunContext {
+                .system = system_info(),
+                .environment = environment,
+                .clock = config_.clock,
+                .overhead = overhead,
+                .batch_size = config_.batch_size,
+                .subtract_overhead = config_.subtract_overhead,
+                .allocation_tracking = detail::allocation_tracking,
+                .name_width = name_width,
+                .iterations_width = iterations_width,
+            });
+        results_.clear();
+        if (!config_.profile.empty()) {
+            // Truncated, the runs then append to it.
+            if (std::FILE* out = std::fopen(config_.profile.c_str(), "w")) {
+                std::fclose(out);
+            }
+        }
+        refused_ = config_.strict_environment && !environment.warnings.empty();
+        if (refused_) {
+            std::fprintf(stderr, "uscope: refusing to run with strict_environment:\n");
+            for (const std::string& warning : environment.warnings) {
+                std::fprintf(stderr, "  %s\n", warning.c_str());
+            }
+            output.finalize();
+            return;
+        }
+        const auto add_aggregates = [&](size_t first) {
+            const std::span<const BenchmarkResult> runs(
+                results_.data() + first,
+                results_.size() - first);
+            for (BenchmarkResult& aggregate : detail::aggregate_repetitions(runs)) {
+                results_.push_back(std::move(aggregate));
+                output.report_run(results_.back());
+            }
+        };
+        const auto add_complexity = [&](const Benchmark& benchmark, size_t first) {
+            const std::span<const BenchmarkResult> family(
+                results_.data() + first,
+                results_.size() - first);
+            std::vector<BenchmarkResult> summaries = complexity_results(benchmark, family);
+            std::ranges::move(knee_results(benchmark, family), std::back_inserter(summaries));
+            for (BenchmarkResult& summary : summaries) {
+                results_.push_back(std::move(summary));
+                output.report_run(results_.back());
+            }
+        };
+
+        if (config_.parallel_suite && !isolated()) {
+            std::vector<SuiteRun> runs = run_suite_in_parallel(benchmarks, repetitions, overhead);
+            size_t family_first = 0;
+            for (size_t index = 0; index < runs.size(); ++index) {
+                const size_t first = results_.size();
+                SuiteRun& run = runs[index];
+                for (BenchmarkResult& result : run.results) {
+                    results_.push_back(std::move(result));
+                    output.report_run(results_.back());
+                }
+                add_aggregates(first);
+                if (index + 1 == runs.size() || runs[index + 1].benchmark != run.benchmark) {
+                    add_complexity(*run.benchmark, family_first);
+                    family_first = results_.size();
+                }
+            }
+            output.finalize();
+            return;
+        }
+
+        if (isolated() || !config_.interleave_repetitions || repetitions == 1) {
+            for (Benchmark* const& family : benchmarks) {
+                const size_t family_first = results_.size();
+                for_each_run(
+                    std::span(&family, 1),
+                    [&](Benchmark& benchmark,
+                        std::span<const Argument> arguments,
+                        std::string name,
+                        int thread_count) {
+                        const size_t first = results_.size();
+                        if (isolated()) {
+                            for (BenchmarkResult& result : run_isolated(
+                                     benchmark,
+                                     arguments,
+                                     name,
+                                     thread_count,
+                                     repetitions,
+                                     overhead)) {
+                                results_.push_back(std::move(result));
+                                output.report_run(results_.back());
+                            }
+                        } else {
+                            const Iteration iteration_count
+                                = iteration_count_for(benchmark, arguments, thread_count);
+                            for (int repetition = 0; repetition < repetitions; ++repetition) {
+                                results_.push_back(run_benchmark(
+                                    benchmark,
+                                    arguments,
+                                    name,
+                                    thread_count,
+                                    iteration_count,
+                                    repetition,
+                                    overhead));
+                                output.report_run(results_.back());
+                            }
+                        }
+                        add_aggregates(first);
+                    });
+                add_complexity(*family, family_first);
+            }
+            output.finalize();
+            return;
+        }
+
+        struct Run {
+            Benchmark* benchmark;
+            std::vector<Argument> arguments;
+            std::string name;
+            int thread_count;
+            Iteration iteration_count;
+            std::vector<BenchmarkResult> repetitions;
+        };
+        std::vector<Run> runs;
+        for_each_run(
+            benchmarks,
+            [&](Benchmark& benchmark,
+                std::span<const Argument> arguments,
+                std::string name,
+                int thread_count) {
+                runs.push_back(Run {
+                    .benchmark = &benchmark,
+                    .arguments = std::vector<Argument>(arguments.begin(), arguments.end()),
+                    .name = std::move(name),
+                    .thread_count = thread_count,
+                    .iteration_count = 0,
+                    .repetitions = {},
+                });
+            });
+        for (int repetition = 0; repetition < repetitions; ++repetition) {
+            for (Run& run : runs) {
+                if (repetition == 0) {
+                    run.iteration_count
+                        = iteration_count_for(*run.benchmark, run.arguments, run.thread_count);
+                }
+                run.repetitions.push_back(run_benchmark(
+                    *run.benchmark,
+                    run.arguments,
+                    run.name,
+                    run.thread_count,
+                    run.iteration_count,
+                    repetition,
+                    overhead));
+                output.report_run(run.repetitions.back());
+            }
+        }
+        size_t family_first = 0;
+        for (size_t index = 0; index < runs.size(); ++index) {
+            Run& run = runs[index];
+            const size_t first = results_.size();
+            std::ranges::move(run.repetitions, std::back_inserter(results_));
+            add_aggregates(first);
+            if (index + 1 == runs.size() || runs[index + 1].benchmark != run.benchmark) {
+                add_complexity(*run.benchmark, family_first);
+                family_first = results_.size();
+            }
+        }
+        output.finalize();
+    }
+
+    struct SuiteRun {
+        Benchmark* benchmark;
+        std::vector<Argument> arguments;
+        std::string name;
+        int thread_count;
+        double estimate_ns;
+        std::vector<BenchmarkResult> results;
+    };
+
+    std::vector<SuiteRun> run_suite_in_parallel(
+        std::span<Benchmark* const> benchmarks,
+        int repetitions,
+        const TimingOverhead& overhead)
+    {
+        std::vector<SuiteRun> runs;
+        for_each_run(
+            benchmarks,
+            [&](Benchmark& benchmark,
+                std::span<const Argument> arguments,
+                std::string name,
+                int thread_count) {
+                runs.push_back(SuiteRun {
+                    .benchmark = &benchmark,
+                    .arguments = std::vector<Argument>(arguments.begin(), arguments.end()),
+                    .name = std::move(name),
+                    .thread_count = thread_count,
+                    .estimate_ns = 0.0,
+                    .results = {},
+                });
+            });
+        estimate_durations(runs);
+
+        const auto run_repetitions = [&](SuiteRun& run) {
+            run.results = this->run_repetitions(
+                *run.benchmark,
+                run.arguments,
+                run.name,
+                run.thread_count,
+                repetitions,
+                overhead);
+        };
+
+        std::vector<size_t> order;
+        for (size_t index = 0; index < runs.size(); ++index) {
+            if (runs[index].thread_count == 1) {
+                order.push_back(index);
+            }
+        }
+        std::ranges::stable_sort(order, std::ranges::greater {}, [&](size_t index) {
+            return runs[index].estimate_ns;
+        });
+        // One shared queue, longest first: whichever worker is idle takes the longest run left.
+        const std::vector<int> cpus = detail::suite_cpus(config_.suite_cpus);
+        std::atomic<size_t> next { 0 };
+        {
+            std::vector<std::jthread> threads;
+            threads.reserve(cpus.size());
+            for (const int cpu : cpus) {
+                threads.emplace_back([&, cpu] {
+                    const detail::ScopedPlacement pinned(Placement { .cpus = { cpu } }, 0, 1);
+                    for (size_t position = next++; position < order.size(); position = next++) {
+                        run_repetitions(runs[order[position]]);
+                    }
+                });
+            }
+        }
+        for (SuiteRun& run : runs) {
+            if (run.thread_count > 1) {
+                run_repetitions(run);
+            }
+        }
+        return runs;
+    }
+
+    [[nodiscard]] bool isolated() const
+    {
+#if defined(__linux__)
+        return config_.isolate;
+#else
+        return false;
+#endif
+    }
+
+    // Calibrates the run, then measures each of its repetitions.
+    std::vector<BenchmarkResult> run_repetitions(
+        Benchmark& benchmark,
+        std::span<const Argument> arguments,
+        const std::string& name,
+        int thread_count,
+        int repetitions,
+        const TimingOverhead& overhead)
+    {
+        const Iteration iteration_count = iteration_count_for(benchmark, arguments, thread_count);
+        std::vector<BenchmarkResult> results;
+        for (int repetition = 0; repetition < repetitions; ++repetition) {
+            results.push_back(run_benchmark(
+                benchmark,
+                arguments,
+                name,
+                thread_count,
+                iteration_count,
+                repetition,
+                overhead));
+        }
+        return results;
+    }
+
+    // run_repetitions() in a forked child, see Config::isolate. The child writes its results as
+    // size-prefixed binary result payloads after their total size, which stays 0 if it dies first.
+    std::vector<BenchmarkResult> run_isolated(
+        Benchmark& benchmark,
+        std::span<const Argument> arguments,
+        const std::string& name,
+        int thread_count,
+        int repetitions,
+        const TimingOverhead& overhead)
+    {
+#if defined(__linux__)
+        const auto failed = [&](std::string error) {
+            std::vector<BenchmarkResult> results(1);
+            BenchmarkResult& result = results.front();
+            result.name = name;
+            result.arguments.assign(arguments.begin(), arguments.end());
+            result.threads = thread_count;
+            result.error = std::move(error);
+            result.complexity_n = arguments.empty() ? 0 : arguments.front();
+            result.complexity = benchmark.complexity();
+            return results;
+        };
+        const std::span<std::byte> shared = result_buffer_.bytes();
+        if (shared.empty()) {
+            return failed(std::string("could not map the result buffer: ") + std::strerror(errno));
+        }
+        uint64_t size = 0;
+        std::memcpy(shared.data(), &size, sizeof(size));
+        // Whatever is buffered would otherwise be written again by the child.
+        std::fflush(nullptr);
+        const pid_t child = fork();
+        if (child < 0) {
+            return failed(std::string("could not fork: ") + std::strerror(errno));
+        }
+        if (child == 0) {
+            detail::BinaryWriter payloads;
+            detail::BinaryWriter payload;
+            for (const BenchmarkResult& result : run_repetitions(
+                     benchmark,
+                     arguments,
+                     name,
+                     thread_count,
+                     repetitions,
+                     overhead)) {
+                payload.clear();
+                detail::put_result(payload, result);
+                payloads.put(static_cast<uint64_t>(payload.bytes().size()));
+                payloads.put_bytes(payload.bytes().data(), payload.bytes().size());
+            }
+            const std::span<const std::byte> bytes = payloads.bytes();
+            const bool fits = bytes.size() <= shared.size() - sizeof(size);
+            if (fits) {
+                std::memcpy(shared.data() + sizeof(size), bytes.data(), bytes.size());
+                size = bytes.size();
+            } else {
+                size = detail::SharedResultBuffer::kOverflow;
+            }
+            std::memcpy(shared.data(), &size, sizeof(size));
+            std::fflush(nullptr);
+            _exit((fits && size > 0) ? EXIT_SUCCESS : EXIT_FAILURE);
+        }
+
+        const std::optional<int> status = detail::wait_for_child(child, config_.isolation_timeout);
+        if (!status) {
+            std::array<char, 64> seconds {};
+            std::snprintf(
+                seconds.data(),
+                seconds.size(),
+                "%g",
+                std::chrono::duration<double>(config_.isolation_timeout).count());
+            return failed(std::string("timed out after ") + seconds.data() + " s");
+        }
+        if (WIFSIGNALED(*status)) {
+            const int signal = WTERMSIG(*status);
+            return failed(
+                "crashed with signal " + std::to_string(signal) + " (" + strsignal(signal) + ")");
+        }
+        std::memcpy(&size, shared.data(), sizeof(size));
+        if (size == detail::SharedResultBuffer::kOverflow) {
+            return failed(
+                "results exceed the isolation buffer of "
+                + std::to_string(detail::SharedResultBuffer::kCapacity >> 20) + " MiB");
+        }
+        if (WIFEXITED(*status) && WEXITSTATUS(*status) != 0) {
+            return failed("exited with status " + std::to_string(WEXITSTATUS(*status)));
+        }
+        if (size == 0 || size > shared.size() - sizeof(size)) {
+            return failed("exited without results");
+        }
+        std::vector<BenchmarkResult> results;
+        detail::BinaryCursor cursor(shared.subspan(sizeof(size), size));
+        while (cursor.remaining() > 0) {
+            uint64_t payload_size = 0;
+            cursor.get(payload_size);
+            detail::BinaryCursor fields(cursor.take(payload_size));
+            BenchmarkResult& result = results.emplace_back();
+            std::span<const Sample> samples;
+            if (!cursor.ok() || !detail::get_result(fields, result, samples)) {
+                return failed("sent back malformed results");
+            }
+            result.samples.assign(samples.begin(), samples.end());
+        }
+        return results;
+#else
+        return run_repetitions(benchmark, arguments, name, thread_count, repetitions, overhead);
+#endif
+    }
+
+    // Duration of the same runs in Config::suite_estimates, the mean of the known ones for the
+    // others.
+    void estimate_durations(std::vector<SuiteRun>& runs) const
+    {
+        if (config_.suite_estimates.empty()) {
+            return;
+        }
+        const std::optional<BinaryResultFile> file
+            = BinaryResultFile::open(config_.suite_estimates);
+        if (!file) {
+            std::fprintf(stderr, "uscope: could not read %s\n", config_.suite_estimates.c_str());
+            return;
+        }
+        std::map<std::string, double, std::less<>> durations;
+        for (const BinaryResultFile::Run& previous : file->runs()) {
+            const BenchmarkResult& result = previous.result;
+            if (result.iterations_per_second > 0.0) {
+                durations[result.name] += static_cast<double>(result.iterations) * 1e9
+                    / result.iterations_per_second;
+            }
+        }
+        double known = 0.0;
+        size_t known_count = 0;
+        for (SuiteRun& run : runs) {
+            const auto it = durations.find(run.name);
+            if (it != durations.end()) {
+                run.estimate_ns = it->second;
+                known += it->second;
+                ++known_count;
+            }
+        }
+        const double mean = (known_count > 0) ? known / static_cast<double>(known_count) : 0.0;
+        for (SuiteRun& run : runs) {
+            if (!durations.contains(run.name)) {
+                run.estimate_ns = mean;
+            }
+        }
+    }
+
+    static constexpr std::string_view kBigOSuffix = "_BigO";
+    static constexpr std::string_view kRmsSuffix = "_RMS";
+
+    // Family name with the thread count suffix of the run, if any, then suffix.
+    [[nodiscard]] static std::string complexity_name(
+        const Benchmark& benchmark,
+        std::span<const Argument> arguments,
+        std::string_view run_name,
+        std::string_view suffix)
+    {
+        std::string name = benchmark.family_name();
+        name += run_name.substr(std::min(benchmark.run_name(arguments).size(), run_name.size()));
+        name += suffix;
+        return name;
+    }
+
+    // A BigO and an RMS result for each thread count of the family, fitted over the time of every
+    // repetition of its runs.
+    [[nodiscard]] static std::vector<BenchmarkResult> complexity_results(
+        const Benchmark& benchmark,
+        std::span<const BenchmarkResult> family)
+    {
+        std::vector<BenchmarkResult> fits;
+        if (benchmark.complexity() == Complexity::None) {
+            return fits;
+        }
+        std::vector<std::string> names;
+        std::vector<std::vector<ComplexityPoint>> points;
+        std::vector<int> threads;
+        for (const BenchmarkResult& result : family) {
+            // Runs that crashed or timed out have no time to fit.
+            if (!result.aggregate.empty() || result.iterations == 0) {
+                continue;
+            }
+            std::string name = complexity_name(benchmark, result.arguments, result.name, {});
+            auto it = std::ranges::find(names, name);
+            if (it == names.end()) {
+                names.push_back(std::move(name));
+                points.emplace_back();
+                threads.push_back(result.threads);
+                it = names.end() - 1;
+            }
+            points[static_cast<size_t>(it - names.begin())].push_back(
+                ComplexityPoint { .n = result.complexity_n, .time_ns = result.time_ns });
+        }
+        for (size_t index = 0; index < names.size(); ++index) {
+            const std::optional<ComplexityFit> fit = fit_complexity(
+                points[index],
+                benchmark.complexity(),
+                benchmark.complexity_function());
+            if (!fit) {
+                continue;
+            }
+            for (const auto& [suffix, value] : {
+                     std::pair { kBigOSuffix, fit->coefficient },
+                     std::pair { kRmsSuffix, fit->rms },
+                 }) {
+                BenchmarkResult& result = fits.emplace_back();
+                result.name = names[index] + std::string(suffix);
+                result.threads = threads[index];
+                result.iterations = static_cast<Iteration>(points[index].size());
+                result.raw_time_ns = value;
+                result.time_ns = value;
+                result.aggregate = suffix.substr(1);
+                result.complexity = fit->complexity;
+            }
+        }
+        return fits;
+    }
+
+    // An open-loop run lasts its iteration count divided by its rate, so the count giving min_time
+    // is known without calibrating.
+    Iteration iteration_count_for(
+        Benchmark& benchmark,
+        std::span<const Argument> arguments,
+        int thread_count)
+    {
+        if (const Iteration fixed = benchmark_config(benchmark).iteration_count; fixed > 0) {
+            return fixed;
+        }
+        const double rate = open_loop_rate(benchmark, arguments);
+        if (rate > 0.0) {
+            const double seconds = std::chrono::duration<double>(config_.min_time).count();
+            return std::clamp<Iteration>(
+                static_cast<Iteration>(std::ceil(rate * seconds / thread_count)),
+                1,
+                config_.max_iterations);
+        }
+        return calibrate_iteration_count(benchmark, arguments, thread_count);
+    }
+
+    [[nodiscard]] static double open_loop_rate(
+        const Benchmark& benchmark,
+        std::span<const Argument> arguments)
+    {
+        const std::optional<size_t> axis = benchmark.open_loop_axis();
+        return (axis && *axis < arguments.size()) ? static_cast<double>(arguments[*axis]) : 0.0;
+    }
+
+    static constexpr double kKneeSustainedRatio = 0.95;
+    static constexpr double kKneeLatencyGrowth = 4.0;
+
+    // For every rate sweep of the family, a copy of the run at the fastest rate that was sustained
+    // within 5% with a p99 latency below 4 times the one at the lowest rate, named _knee. Medians
+    // are used when the runs were repeated.
+    [[nodiscard]] static std::vector<BenchmarkResult> knee_results(
+        const Benchmark& benchmark,
+        std::span<const BenchmarkResult> family)
+    {
+        std::vector<BenchmarkResult> knees;
+        const std::optional<size_t> axis = benchmark.open_loop_axis();
+        if (!axis) {
+            return knees;
+        }
+        const bool repeated = std::ranges::any_of(family, [](const BenchmarkResult& result) {
+            return result.aggregate == "median";
+        });
+        const std::string_view kind = repeated ? "median" : "";
+        // Sweeps are told apart by their name without the rate.
+        std::vector<std::pair<std::string, std::vector<const BenchmarkResult*>>> sweeps;
+        for (const BenchmarkResult& result : family) {
+            if (result.aggregate != kind || result.arguments.size() <= *axis) {
+                continue;
+            }
+            // The thread count suffix sits between the run name and the aggregate suffix.
+            const size_t run_size = benchmark.run_name(result.arguments).size();
+            const size_t aggregate_size = kind.empty() ? 0 : kind.size() + 1;
+            std::string name = benchmark.run_name(result.arguments, axis)
+                + result.name.substr(run_size, result.name.size() - run_size - aggregate_size);
+            auto it = std::ranges::find(sweeps, name, &decltype(sweeps)::value_type::first);
+            if (it == sweeps.end()) {
+                it = sweeps.insert(sweeps.end(), { std::move(name), {} });
+            }
+            it->second.push_back(&result);
+        }
+        for (auto& [name, runs] : sweeps) {
+            if (runs.size() < 2) {
+                continue;
+            }
+            std::ranges::sort(runs, {}, [&](const BenchmarkResult* run) {
+                return run->arguments[*axis];
+            });
+            const double baseline_p99 = runs.front()->p99_ns;
+            const BenchmarkResult* knee = nullptr;
+            for (const BenchmarkResult* run : runs) {
+                const auto rate = static_cast<double>(run->arguments[*axis]);
+                if (run->iterations_per_second < kKneeSustainedRatio * rate
+                    || run->p99_ns > kKneeLatencyGrowth * baseline_p99) {
+                    break;
+                }
+                knee = run;
+            }
+            if (knee == nullptr) {
+                continue;
+            }
+            BenchmarkResult& result = knees.emplace_back(*knee);
+            result.name = name + "_knee";
+            result.aggregate = "knee";
+            result.histogram.clear();
+            result.samples.clear();
+            result.outliers = {};
+            result.counters.emplace_back(
+                "rate",
+                Counter { .value = static_cast<double>(knee->arguments[*axis]) });
+        }
+        return knees;
+    }
+
+    // Runs the benchmark on thread_count threads, each with its own state, the calling thread
+    // being the first of them.
+    std::vector<BenchmarkState> execute_threads(
+        Benchmark& benchmark,
+        std::span<const Argument> arguments,
+        Iteration iteration_count,
+        int thread_count,
+        std::vector<int>* effective_cpus = nullptr,
+        bool profiled = false)
+    {
+        Config config = benchmark_config(benchmark);
+        if (!profiled) {
+            config.profile.clear();
+        }
+        config.cache_mode = benchmark.cache_mode().value_or(config_.cache_mode);
+        config.open_loop_rate = open_loop_rate(benchmark, arguments);
+        config.arrivals = benchmark.arrivals();
+        std::vector<BenchmarkState> states;
+        states.reserve(static_cast<size_t>(thread_count));
+        std::barrier<> start_barrier(thread_count);
+        std::barrier<>* barrier = (thread_count > 1) ? &start_barrier : nullptr;
+        for (int thread_index = 0; thread_index < thread_count; ++thread_index) {
+            states.emplace_back(
+                iteration_count,
+                config,
+                thread_index,
+                thread_count,
+                barrier,
+                arguments,
+                &data_cache_);
+        }
+        const Placement& placement
+            = benchmark.placement() ? *benchmark.placement() : config_.placement;
+        std::vector<std::vector<int>> thread_cpus(states.size());
+        const auto run = [&](BenchmarkState& state) {
+            const detail::ScopedPlacement scoped_placement(
+                placement,
+                state.thread_index(),
+                state.thread_count());
+            thread_cpus[static_cast<size_t>(state.thread_index())]
+                = detail::ScopedPlacement::effective_cpus();
+            benchmark.execute(state);
+            state.finish_thread();
+        };
+        {
+            std::vector<std::jthread> workers;
+            workers.reserve(states.size() - 1);
+            for (size_t thread_index = 1; thread_index < states.size(); ++thread_index) {
+                workers.emplace_back(run, std::ref(states[thread_index]));
+            }
+            run(states.front());
+        }
+        if (effective_cpus != nullptr) {
+            effective_cpus->clear();
+            for (const auto& cpus : thread_cpus) {
+                effective_cpus->insert(effective_cpus->end(), cpus.begin(), cpus.end());
+            }
+            std::ranges::sort(*effective_cpus);
+            const auto duplicates = std::ranges::unique(*effective_cpus);
+            effective_cpus->erase(duplicates.begin(), duplicates.end());
+        }
+        return states;
+    }
+
+    BenchmarkResult run_benchmark(
+        Benchmark& benchmark,
+        std::span<const Argument> arguments,
+        std::string name,
+        int thread_count,
+        Iteration iteration_count,
+        int repetition,
+        const TimingOverhead& suite_overhead)
+    {
+        const auto found = static_overheads_.find(&benchmark);
+        const TimingOverhead& timing_overhead
+            = (found != static_overheads_.end()) ? found->second : suite_overhead;
+        std::vector<int> effective_cpus;
+        auto states = execute_threads(
+            benchmark,
+            arguments,
+            iteration_count,
+            thread_count,
+            &effective_cpus,
+            true);
+        const auto measurement = std::make_unique<detail::Measurement>(states);
+        if (!config_.profile.empty()) {
+            write_profile(name, states);
+        }
+
+        const double raw_time = measurement->mean_iteration_ns();
+        const double pauses_per_iteration = measurement->pauses_per_iteration();
+        const double overhead = timing_overhead.keep_running_ns
+            + (pauses_per_iteration * timing_overhead.pause_resume_ns);
+        const double shift = config_.subtract_overhead ? overhead : 0.0;
+        const auto adjusted = [&](double value) {
+            return std::max(value - shift, 0.0);
+        };
+        const auto per_iteration = [&](uint64_t total) {
+            return (measurement->iterations > 0)
+                ? static_cast<double>(total) / static_cast<double>(measurement->iterations)
+                : 0.0;
+        };
+        const RunningStatistics& statistics = measurement->statistics;
+        const auto quantile = [&](double q) {
+            return adjusted(std::clamp(
+                measurement->histogram.value_at_quantile(q),
+                statistics.min(),
+                statistics.max()));
+        };
+        return BenchmarkResult {
+            .name = std::move(name),
+            .arguments = std::vector<Argument>(arguments.begin(), arguments.end()),
+            .threads = thread_count,
+            .affinity = format_cpu_list(effective_cpus),
+            .iterations_per_second = (measurement->wall_ns > 0.0)
+                ? static_cast<double>(measurement->iterations) * 1e9 / measurement->wall_ns
+                : 0.0,
+            .iterations = measurement->iterations,
+            .raw_time_ns = raw_time,
+            .time_ns = adjusted(raw_time),
+            .overhead_ns = overhead,
+            .pauses_per_iteration = pauses_per_iteration,
+            .allocations_per_iteration = per_iteration(measurement->allocations),
+            .allocated_bytes_per_iteration = per_iteration(measurement->allocated_bytes),
+            .unreliable = raw_time < (config_.unreliable_overhead_ratio * overhead),
+            .error = allocation_error(benchmark, *measurement),
+            .stddev_ns = statistics.stddev(),
+            .min_ns = adjusted(statistics.min()),
+            .p50_ns = quantile(0.5),
+            .p90_ns = quantile(0.9),
+            .p99_ns = quantile(0.99),
+            .p999_ns = quantile(0.999),
+            .max_ns = adjusted(statistics.max()),
+            .perf_counters = perf_counters_per_iteration(*measurement),
+            .counters = finalized_counters(*measurement),
+            .histogram = measurement->histogram.buckets(),
+            .samples = std::move(measurement->samples),
+            .outliers = classify_outliers(measurement->histogram, config_.outlier_method),
+            .repetition = repetition,
+            .aggregate = {},
+            .complexity_n
+            = measurement->complexity_n.value_or(arguments.empty() ? 0 : arguments.front()),
+            .complexity = benchmark.complexity(),
+        };
+    }
+
+    // One line per distinct stack sampled on any thread of the run, from the root, with the return
+    // addresses of the callers moved back into their call instruction.
+    void write_profile(std::string_view name, std::vector<BenchmarkState>& states)
+    {
+#if defined(__linux__)
+        detail::StackCounts stacks;
+        for (BenchmarkState& state : states) {
+            for (const auto& [stack, count] : state.profile_stacks()) {
+                stacks[stack] += count;
+            }
+        }
+        if (stacks.empty()) {
+            return;
+        }
+        const std::lock_guard lock(profile_mutex_);
+        // Stacks through different addresses of the same functions fold into one line.
+        std::map<std::string, uint64_t> folded;
+        for (const auto& [stack, count] : stacks) {
+            std::string line(name);
+            for (size_t index = stack.size(); index-- > 0;) {
+                line += ';';
+                line += symbolizer_.name((index == 0) ? stack[index] : stack[index] - 1);
+            }
+            folded[line] += count;
+        }
+        std::string buffer;
+        for (const auto& [line, count] : folded) {
+            buffer += line;
+            buffer += ' ';
+            buffer += std::to_string(count);
+            buffer += '\n';
+        }
+        std::FILE* out = std::fopen(config_.profile.c_str(), "a");
+        if (out == nullptr) {
+            std::fprintf(stderr, "uscope: could not write %s\n", config_.profile.c_str());
+            return;
+        }
+        std::fwrite(buffer.data(), 1, buffer.size(), out);
+        std::fclose(out);
+#else
+        static_cast<void>(name);
+        static_cast<void>(states);
+#endif
+    }
+
+    [[nodiscard]] static std::string allocation_error(
+        const Benchmark& benchmark,
+        const detail::Measurement& measurement)
+    {
+        if (!benchmark.allocations_forbidden()) {
+            return {};
+        }
+        if (!detail::allocation_tracking) {
+            return "allocations are not tracked, define USCOPE_TRACK_ALLOCATIONS in one "
+                   "translation unit";
+        }
+        if (measurement.allocations == 0) {
+            return {};
+        }
+        return "allocated " + std::to_string(measurement.allocations) + " times ("
+            + std::to_string(measurement.allocated_bytes) + " bytes) in "
+            + std::to_string(measurement.iterations) + " iterations";
+    }
+
+    [[nodiscard]] static std::vector<std::pair<std::string, Counter>>
+    finalized_counters(const detail::Measurement& measurement)
+    {
+        std::vector<std::pair<std::string, Counter>> counters = measurement.counters;
+        const double thread_seconds = measurement.thread_elapsed_ns() * 1e-9;
+        for (auto& [name, counter] : counters) {
+            counter = detail::finalize_counter(
+                counter,
+                thread_seconds,
+                measurement.threads,
+                measurement.iterations);
+        }
+        return counters;
+    }
+
+    [[nodiscard]] std::vector<std::pair<std::string, double>>
+    perf_counters_per_iteration(const detail::Measurement& measurement) const
+    {
+        std::vector<std::pair<std::string, double>> counters;
+        const auto& totals = measurement.perf_counter_totals;
+        if (totals.size() != config_.perf_counters.size() || measurement.iterations <= 0) {
+            return counters;
+        }
+        std::optional<double> cycles;
+        std::optional<double> instructions;
+        for (size_t index = 0; index < totals.size(); ++index) {
+            const auto total = static_cast<double>(totals[index]);
+            const PerfCounter& counter = config_.perf_counters[index];
+            counters.emplace_back(
+                counter.name,
+                total / static_cast<double>(measurement.iterations));
+#if defined(__linux__)
+            if (counter.type == PERF_TYPE_HARDWARE && counter.config == PERF_COUNT_HW_CPU_CYCLES) {
+                cycles = total;
+            }
+            if (counter.type == PERF_TYPE_HARDWARE
+                && counter.config == PERF_COUNT_HW_INSTRUCTIONS) {
+                instructions = total;
+            }
+#endif
+        }
+        if (cycles && instructions && *cycles > 0.0) {
+            counters.emplace_back("IPC", *instructions / *cycles);
+        }
+        return counters;
+    }
+
+    Iteration calibrate_iteration_count(
+        Benchmark& benchmark,
+        std::span<const Argument> arguments,
+        int thread_count)
+    {
+        static constexpr double kMinGrowth = 2.0;
+        static constexpr double kMaxGrowth = 10.0;
+        // Aim slightly above min_time so the measurement run does not land just below it.
+        static constexpr double kOvershoot = 1.4;
+
+        const auto min_time = static_cast<double>(config_.min_time.count());
+        const auto max_time = static_cast<double>(config_.max_time.count());
+        const Iteration max_iterations = std::max<Iteration>(config_.max_iterations, 1);
+        Iteration iteration_count
+            = std::clamp<Iteration>(benchmark_config(benchmark).batch_size, 1, max_iterations);
+        double spent = 0.0;
+        while (true) {
+            const auto measurement = std::make_unique<detail::Measurement>(
+                execute_threads(benchmark, arguments, iteration_count, thread_count));
+
+            const double elapsed = std::max(measurement->thread_elapsed_ns(), 1.0);
+            spent += elapsed;
+            const bool long_enough = elapsed >= min_time;
+            const bool precise_enough = config_.target_relative_error <= 0.0
+                || measurement->statistics.relative_standard_error()
+                    <= config_.target_relative_error;
+            if ((long_enough && precise_enough) || iteration_count >= max_iterations) {
+                return iteration_count;
+            }
+
+            const double growth = std::clamp(
+                long_enough ? kMinGrowth : (min_time * kOvershoot / elapsed),
+                kMinGrowth,
+                kMaxGrowth);
+            if (long_enough && spent + (2.0 * elapsed * growth) > max_time) {
+                return iteration_count;
+            }
+            const double next = std::min(
+                static_cast<double>(iteration_count) * growth,
+                static_cast<double>(max_iterations));
+            iteration_count = static_cast<Iteration>(next);
+        }
+    }
+
+    Config config_;
+    std::optional<std::regex> filter_;
+    BenchmarkList benchmarks_;
+    std::forward_list<Benchmark> owned_benchmarks_;
+    std::vector<BenchmarkResult> results_;
+    std::map<const Benchmark*, TimingOverhead> static_overheads_;
+    DataCache data_cache_;
+    bool refused_ { false };
+#if defined(__linux__)
+    detail::SharedResultBuffer result_buffer_;
+    // Workers of the parallel suite symbolize and append their profiles one at a time.
+    std::mutex profile_mutex_;
+    detail::Symbolizer symbolizer_;
+#endif
+    Reporter* reporter_;
+    ConsoleReporter console_reporter_;
+};
+
+enum class OutputFormat : uint8_t {
+    Console,
+    Json,
+    Csv,
+    Binary,
+};
+
+inline std::unique_ptr<Reporter> make_reporter(OutputFormat format, std::FILE* out)
+{
+    switch (format) {
+    case OutputFormat::Json:
+        return std::make_unique<JsonReporter>(out);
+    case OutputFormat::Csv:
+        return std::make_unique<CsvReporter>(out);
+    case OutputFormat::Binary:
+        return std::make_unique<BinaryReporter>(out);
+    case OutputFormat::Console:
+        break;
+    }
+    return std::make_unique<ConsoleReporter>(out);
+}
+
+// What uscope::main() runs, from its command line.
+struct CommandLine {
+    Config config;
+    // Of the results on stdout.
+    OutputFormat format { OutputFormat::Console };
+    // A file also receiving the results, in output_format.
+    std::string output {};
+    OutputFormat output_format { OutputFormat::Json };
+    bool list { false };
+    bool help { false };
+};
+
+constexpr std::string_view kUsage
+    = "usage: %s [options] [filter]\n"
+      "  --filter REGEX            run the benchmarks whose name matches REGEX\n"
+      "  --min_time TIME           calibrate to at least TIME per run (500ms, 2s, 10us), or\n"
+      "                            run N iterations with Nx\n"
+      "  --max_time TIME           time budget of the calibration of each run\n"
+      "  --repetitions N           repeat each run and report aggregates\n"
+      "  --interleave              interleave the repetitions of all runs\n"
+      "  --threads N,M,...         thread counts of the runs\n"
+      "  --format FORMAT           console, json, csv or binary output on stdout\n"
+      "  --output FILE             also write the results to FILE\n"
+      "  --output_format FORMAT    format of FILE, json by default\n"
+      "  --isolate                 run each run in a child process\n"
+      "  --parallel                run the single-threaded runs concurrently\n"
+      "  --strict                  refuse to run on a noisy machine\n"
+      "  --profile FILE            write folded stacks of the timed regions to FILE\n"
+      "  --list                    list the runs without running them\n"
+      "  --help                    show this help\n"
+      "Flags also take --flag=value, and the --benchmark_ prefix of Google Benchmark.\n";
+
+namespace detail {
+
+inline bool parse_format(std::string_view text, OutputFormat& format)
+{
+    static constexpr std::array<std::pair<std::string_view, OutputFormat>, 4> kFormats { {
+        { "console", OutputFormat::Console },
+        { "json", OutputFormat::Json },
+        { "csv", OutputFormat::Csv },
+        { "binary", OutputFormat::Binary },
+    } };
+    const auto it = std::ranges::find(kFormats, text, &decltype(kFormats)::value_type::first);
+    if (it == kFormats.end()) {
+        return false;
+    }
+    format = it->second;
+    return true;
+}
+
+template<typename T>
+bool parse_integer(std::string_view text, T& value)
+{
+    const auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+    return result.ec == std::errc {} && result.ptr == text.data() + text.size() && value > 0;
+}
+
+// A number with a unit among ns, us, ms and s, seconds without one.
+inline bool parse_duration(std::string_view text, std::chrono::nanoseconds& duration)
+{
+    static constexpr std::array<std::pair<std::string_view, double>, 4> kUnits { {
+        { "ns", 1.0 },
+        { "us", 1e3 },
+        { "ms", 1e6 },
+        { "s", 1e9 },
+    } };
+    double scale = 1e9;
+    for (const auto& [unit, unit_scale] : kUnits) {
+        if (text.ends_with(unit)) {
+            text.remove_suffix(unit.size());
+            scale = unit_scale;
+            break;
+        }
+    }
+    double value = 0.0;
+    const auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (result.ec != std::errc {} || result.ptr != text.data() + text.size() || value < 0.0) {
+        return false;
+    }
+    duration = std::chrono::nanoseconds(static_cast<int64_t>(value * scale));
+    return true;
+}
+
+inline bool parse_thread_counts(std::string_view text, std::vector<int>& threads)
+{
+    threads.clear();
+    while (!text.empty()) {
+        const size_t comma = std::min(text.find(','), text.size());
+        int count = 0;
+        if (!parse_integer(text.substr(0, comma), count)) {
+            return false;
+        }
+        threads.push_back(count);
+        text.remove_prefix(std::min(comma + 1, text.size()));
+    }
+    return !threads.empty();
+}
+
+// std::regex reports invalid expressions with an exception only.
+inline bool valid_regex(const std::string& expression)
+{
+    try {
+        std::regex { expression };
+        return true;
+    } catch (const std::regex_error&) {
+        return false;
+    }
+}
+
+} // namespace detail
+
+// Empty after reporting the first invalid argument on stderr.
+inline std::optional<CommandLine> parse_command_line(int argc, char** argv)
+{
+    CommandLine command_line;
+    Config& config = command_line.config;
+    for (int index = 1; index < argc; ++index) {
+        const char* const argument = argv[index];
+        std::string_view flag = argument;
+        std::optional<std::string_view> value;
+        if (const size_t equals = flag.find('='); flag.starts_with("--") && equals != flag.npos) {
+            value = flag.substr(equals + 1);
+            flag = flag.substr(0, equals);
+        }
+        if (flag.starts_with("--benchmark_")) {
+            flag.remove_prefix(std::string_view("--benchmark_").size());
+        } else if (flag.starts_with("--")) {
+            flag.remove_prefix(2);
+        } else if (config.filter.empty()) {
+            flag = "filter";
+            value = argv[index];
+        } else {
+            std::fprintf(stderr, "uscope: unexpected argument %s\n", argv[index]);
+            return std::nullopt;
+        }
+        const auto take_value = [&]() -> std::optional<std::string_view> {
+            if (!value && index + 1 < argc) {
+                value = argv[++index];
+            }
+            return value;
+        };
+        bool valid = true;
+        if (flag == "isolate" || flag == "parallel" || flag == "strict" || flag == "interleave"
+            || flag == "list" || flag == "help") {
+            valid = !value;
+            config.isolate = config.isolate || flag == "isolate";
+            config.parallel_suite = config.parallel_suite || flag == "parallel";
+            config.strict_environment = config.strict_environment || flag == "strict";
+            config.interleave_repetitions = config.interleave_repetitions || flag == "interleave";
+            command_line.list = command_line.list || flag == "list";
+            command_line.help = command_line.help || flag == "help";
+        } else if (!take_value()) {
+            valid = false;
+        } else if (flag == "filter") {
+            config.filter = *value;
+            valid = detail::valid_regex(config.filter);
+        } else if (flag == "min_time" && value->ends_with('x')) {
+            valid = detail::parse_integer(
+                value->substr(0, value->size() - 1),
+                config.iteration_count);
+        } else if (flag == "min_time") {
+            valid = detail::parse_duration(*value, config.min_time);
+        } else if (flag == "max_time") {
+            valid = detail::parse_duration(*value, config.max_time);
+        } else if (flag == "repetitions") {
+            valid = detail::parse_integer(*value, config.repetitions);
+        } else if (flag == "threads") {
+            valid = detail::parse_thread_counts(*value, config.threads);
+        } else if (flag == "format") {
+            valid = detail::parse_format(*value, command_line.format);
+        } else if (flag == "output" || flag == "out") {
+            command_line.output = *value;
+        } else if (flag == "output_format" || flag == "out_format") {
+            valid = detail::parse_format(*value, command_line.output_format);
+        } else if (flag == "profile") {
+            config.profile = *value;
+        } else {
+            valid = false;
+        }
+        if (!valid) {
+            std::fprintf(stderr, "uscope: invalid argument %s", argument);
+            if (value && argument != argv[index]) {
+                std::fprintf(stderr, " %.*s", static_cast<int>(value->size()), value->data());
+            }
+            std::fprintf(stderr, "\n");
+            return std::nullopt;
+        }
+    }
+    return command_line;
+}
+
+// Runs the registered benchmarks selected by the command line, see kUsage. Returns 1 when a run
+// failed, none matched or the environment was refused, 2 for an invalid command line.
+inline int main(int argc, char** argv)
+{
+    const char* program = (argc > 0) ? argv[0] : "uscope";
+    const std::optional<CommandLine> command_line = parse_command_line(argc, argv);
+    if (!command_line || command_line->help) {
+        std::FILE* out = command_line ? stdout : stderr;
+        std::fprintf(out, kUsage.data(), program);
+        return command_line ? 0 : 2;
+    }
+    const std::unique_ptr<Reporter> reporter = make_reporter(command_line->format, stdout);
+    std::vector<Reporter*> reporters { reporter.get() };
+    std::unique_ptr<std::FILE, decltype(&std::fclose)> file(nullptr, &std::fclose);
+    std::unique_ptr<Reporter> file_reporter;
+    if (!command_line->output.empty()) {
+        file.reset(std::fopen(command_line->output.c_str(), "wb"));
+        if (!file) {
+            std::fprintf(stderr, "uscope: could not write %s\n", command_line->output.c_str());
+            return 1;
+        }
+        file_reporter = make_reporter(command_line->output_format, file.get());
+        reporters.push_back(file_reporter.get());
+    }
+    TeeReporter tee(std::move(reporters));
+    BenchmarkRunner runner(command_line->config, &tee);
+    const std::vector<std::string> names = runner.registered_run_names();
+    if (names.empty()) {
+        std::fprintf(
+            stderr,
+            "uscope: no benchmark matches %s\n",
+            command_line->config.filter.c_str());
+        return 1;
+    }
+    if (command_line->list) {
+        for (const std::string& name : names) {
+            std::printf("%s\n", name.c_str());
+        }
+        return 0;
+    }
+    runner.run_registered_benchmarks();
+    const bool passed = !runner.refused()
+        && std::ranges::all_of(runner.results(), &std::string::empty, &BenchmarkResult::error);
+    return passed ? 0 : 1;
+}
+
+} // namespace uscope
+
+#define USCOPE_CONCAT_IMPL(a, b) a##b
+#define USCOPE_CONCAT(a, b) USCOPE_CONCAT_IMPL(a, b)
+
+#define USCOPE_BENCHMARK_IMPL(fn, id)                                                           \
+    static ::uscope::Benchmark USCOPE_CONCAT(uscope_benchmark_, id) { #fn, fn };              \
+    [[maybe_unused]] static ::uscope::Benchmark& USCOPE_CONCAT(uscope_registration_, id)      \
+        = ::uscope::BenchmarkRegistry::instance().add(USCOPE_CONCAT(uscope_benchmark_, id))
+
+// Registers fn in the global registry at static initialization, without allocating.
+#define USCOPE_BENCHMARK(fn) USCOPE_BENCHMARK_IMPL(fn, __COUNTER__)
+
+#define USCOPE_BENCHMARK_FIXTURE_IMPL(fixture, fn, id)                                          \
+    static ::uscope::Benchmark USCOPE_CONCAT(uscope_benchmark_, id) {                           \
+        #fn, &::uscope::detail::run_fixture<fixture, fn>                                        \
+    };                                                                                          \
+    [[maybe_unused]] static ::uscope::Benchmark& USCOPE_CONCAT(uscope_registration_, id)        \
+        = ::uscope::BenchmarkRegistry::instance().add(USCOPE_CONCAT(uscope_benchmark_, id))
+
+// Registers fn(fixture&, state), run between the setup and teardown of a fixture per thread.
+#define USCOPE_BENCHMARK_FIXTURE(fixture, fn)                                                   \
+    USCOPE_BENCHMARK_FIXTURE_IMPL(fixture, fn, __COUNTER__)
+
+#define USCOPE_BENCHMARK_ASYNC_IMPL(fn, id)                                                     \
+    static ::uscope::Benchmark USCOPE_CONCAT(uscope_benchmark_, id) {                           \
+        #fn, &::uscope::detail::run_async<fn>                                                   \
+    };                                                                                          \
+    [[maybe_unused]] static ::uscope::Benchmark& USCOPE_CONCAT(uscope_registration_, id)        \
+        = ::uscope::BenchmarkRegistry::instance().add(USCOPE_CONCAT(uscope_benchmark_, id))
+
+// Registers a coroutine fn(state) returning a uscope::Task<>, see AsyncBenchmarkFunction.
+#define USCOPE_BENCHMARK_ASYNC(fn) USCOPE_BENCHMARK_ASYNC_IMPL(fn, __COUNTER__)
+
+#define USCOPE_BENCHMARK_STATIC_IMPL(fn, options, id)                                           \
+    static ::uscope::Benchmark USCOPE_CONCAT(uscope_benchmark_, id) {                           \
+        #fn, &::uscope::detail::run_static<fn, options>                                         \
+    };                                                                                          \
+    [[maybe_unused]] static ::uscope::Benchmark& USCOPE_CONCAT(uscope_registration_, id)        \
+        = ::uscope::BenchmarkRegistry::instance()                                               \
+              .add(USCOPE_CONCAT(uscope_benchmark_, id))                                        \
+              .static_config(options)
+
+// Registers fn(state) compiled for options, a constexpr StaticConfig: fn takes a
+// uscope::StaticState<options>, or a BenchmarkState to only get the settings.
+#define USCOPE_BENCHMARK_STATIC(fn, options) USCOPE_BENCHMARK_STATIC_IMPL(fn, options, __COUNTER__)
+
+#define USCOPE_BENCHMARK_TEMPLATE_IMPL(fn, id, ...)                                             \
+    struct USCOPE_CONCAT(uscope_kernel_, id) {                                                  \
+        template<typename T>                                                                    \
+        static void run(::uscope::BenchmarkState& state)                                        \
+        {                                                                                       \
+            fn<T>(state);                                                                       \
+        }                                                                                       \
+    };                                                                                          \
+    [[maybe_unused]] static ::uscope::BenchmarkGroup USCOPE_CONCAT(uscope_registration_, id)    \
+        = ::uscope::detail::                                                                    \
+            register_typed_benchmarks<USCOPE_CONCAT(uscope_kernel_, id), __VA_ARGS__>(          \
+                #fn,                                                                            \
+                #__VA_ARGS__)
+
+// Registers fn<T> for every type T of the list, named fn<T>, and returns the group for
+// configuring them all at once.
+#define USCOPE_BENCHMARK_TEMPLATE(fn, ...)                                                      \
+    USCOPE_BENCHMARK_TEMPLATE_IMPL(fn, __COUNTER__, __VA_ARGS__)
+
+// Defining USCOPE_TRACK_ALLOCATIONS in exactly one translation unit before including this header
+// replaces the global operator new and delete with malloc-based ones counting the allocations of
+// each thread, reported per iteration by the runner.
+#if defined(USCOPE_TRACK_ALLOCATIONS)
+namespace uscope::detail {
+
+inline void* tracked_allocation(std::size_t size, std::size_t alignment, bool nothrow)
+{
+    ++thread_allocations.allocations;
+    thread_allocations.bytes += size;
+    size = std::max<std::size_t>(size, 1);
+    void* data = nullptr;
+    if (alignment <= alignof(std::max_align_t)) {
+        data = std::malloc(size);
+    } else {
+#if defined(_MSC_VER)
+        data = _aligned_malloc(size, alignment);
+#else
+        data = std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+#endif
+    }
+    if (data == nullptr && !nothrow) {
+        throw std::bad_alloc();
+    }
+    return data;
+}
+
+inline void tracked_deallocation(void* data, std::size_t alignment) noexcept
+{
+#if defined(_MSC_VER)
+    if (alignment > alignof(std::max_align_t)) {
+        _aligned_free(data);
+        return;
+    }
+#else
+    static_cast<void>(alignment);
+#endif
+    std::free(data);
+}
+
+[[maybe_unused]] static const bool allocation_hooks_installed = (allocation_tracking = true);
+
+} // namespace uscope::detail
+
+void* operator new(std::size_t size)
+{
+    return ::uscope::detail::tracked_allocation(size, 0, false);
+}
+
+void* operator new[](std::size_t size)
+{
+    return ::uscope::detail::tracked_allocation(size, 0, false);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    return ::uscope::detail::tracked_allocation(size, 0, true);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+    return ::uscope::detail::tracked_allocation(size, 0, true);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    return ::uscope::detail::tracked_allocation(size, static_cast<std::size_t>(alignment), false);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return ::uscope::detail::tracked_allocation(size, static_cast<std::size_t>(alignment), false);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return ::uscope::detail::tracked_allocation(size, static_cast<std::size_t>(alignment), true);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return ::uscope::detail::tracked_allocation(size, static_cast<std::size_t>(alignment), true);
+}
+
+void operator delete(void* data) noexcept
+{
+    ::uscope::detail::tracked_deallocation(data, 0);
+}
+
+void operator delete[](void* data) noexcept
+{
+    ::uscope::detail::tracked_deallocation(data, 0);
+}
+
+void operator delete(void* data, std::size_t) noexcept
+{
+    ::uscope::detail::tracked_deallocation(data, 0);
+}
+
+void operator delete[](void* data, std::size_t) noexcept
+{
+    ::uscope::detail::tracked_deallocation(data, 0);
+}
+
+void operator delete(void* data, const std::nothrow_t&) noexcept
+{
+    ::uscope::detail::tracked_deallocation(data, 0);
+}
+
+void operator delete[](void* data, const std::nothrow_t&) noexcept
+{
+    ::uscope::detail::tracked_deallocation(data, 0);
+}
+
+void operator delete(void* data, std::align_val_t alignment) noexcept
+{
+    ::uscope::detail::tracked_deallocation(data, static_cast<std::size_t>(alignment));
+}
+
+void operator delete[](void* data, std::align_val_t alignment) noexcept
+{
+    ::uscope::detail::tracked_deallocation(data, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void* data, std::size_t, std::align_val_t alignment) noexcept
+{
+    ::uscope::detail::tracked_deallocation(data, static_cast<std::size_t>(alignment));
+}
+
+void operator delete[](void* data, std::size_t, std::align_val_t alignment) noexcept
+{
+    ::uscope::detail::tracked_deallocation(data, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void* data, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    ::uscope::detail::tracked_deallocation(data, static_cast<std::size_t>(alignment));
+}
+
+void operator delete[](void* data, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    ::uscope::detail::tracked_deallocation(data, static_cast<std::size_t>(alignment));
+}
+#endif
+
+// Defining USCOPE_MAIN in exactly one translation unit before including this header provides a
+// main() running every registered benchmark.
+#if defined(USCOPE_MAIN)
+int main(int argc, char** argv)
+{
+    return ::uscope::main(argc, argv);
+}
+#endif
 
 #endif // USCOPE_HPP_